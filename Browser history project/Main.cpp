@@ -1,6 +1,9 @@
 #include "browser history.h"
+#include "history journal.h"
+#include "history benchmark.h"
 #include <iostream>
 #include <string> 
+#include <thread>
 
 void displayMenu() {
     cout << "\n========== Browser History Navigator ==========\n";
@@ -28,6 +31,7 @@ void displayMenu() {
     cout << "22. Search by title\n";    
     cout << "23. Advanced search\n";
     cout << "24. Exit\n";
+    cout << "25. Run benchmarks\n";
     cout << "Choose an option: ";
 }
 
@@ -41,16 +45,25 @@ int main() {
 
     cout << "Welcome to Browser History Navigator!\n";
 
-    history.addPage("https://www.example.com", "Example Homepage");
-    history.addPage("https://www.example.com/about", "About Example");
-    history.addPage("https://www.example.com://products", "Example Products");
-    history.goBack();
-    history.addPage("https://www.example.com/services", "Example Services");
-    history.goToHome();
-    history.addPage("https://www.example.com/contact", "Contact Example");
-    history.goBack();
-    history.addPage("https://www.example.com/blog", "Example Blog");
-    cout << "Initialized with 5 sample pages.\n";
+    HistoryJournal journal(history, "history.bhst");
+    if (!journal.open()) {
+        cout << "Could not read the saved history; changes in this run will not be saved.\n";
+    }
+    if (history.getRootPage()) {
+        cout << "Restored " << history.getSize() << " pages from the previous run.\n";
+    }
+    else {
+        history.addPage("https://www.example.com", "Example Homepage");
+        history.addPage("https://www.example.com/about", "About Example");
+        history.addPage("https://www.example.com://products", "Example Products");
+        history.goBack();
+        history.addPage("https://www.example.com/services", "Example Services");
+        history.goToHome();
+        history.addPage("https://www.example.com/contact", "Contact Example");
+        history.goBack();
+        history.addPage("https://www.example.com/blog", "Example Blog");
+        cout << "Initialized with 5 sample pages.\n";
+    }
 
     while (running) {
         displayMenu();
@@ -300,8 +313,7 @@ int main() {
 
                         if (resultIndex > 0 && resultIndex <= results.size())
                         {
-                            Page* selectedPage = results[resultIndex - 1];
-                            history.goToURL(selectedPage->getUrl());
+                            history.goToPage(results[resultIndex - 1]);
                             cout << "Navigated to: " << history.getCurrentPage()->getTitle() << endl;
                         }
                         else
@@ -389,8 +401,7 @@ int main() {
 
                     if (resultIndex > 0 && resultIndex <= results.size())
                     {
-                        Page* selectedPage = results[resultIndex - 1];
-                        history.goToURL(selectedPage->getUrl());
+                        history.goToPage(results[resultIndex - 1]);
                         cout << "Navigated to: " << history.getCurrentPage()->getTitle() << endl;
                     }
                     else
@@ -403,13 +414,46 @@ int main() {
         break;
 
         case 24:
+            if (!journal.flush()) {
+                cout << "Could not save history." << endl;
+            }
             cout << "Exiting program. Goodbye!" << endl;
             running = false;
             break;
 
+        case 25:
+        {
+            int benchmark = 0;
+            cout << "1. Allocations per full-history scan\n";
+            cout << "2. Concurrent readers and writer throughput\n";
+            cout << "3. Search scan scaling across threads\n";
+            cout << "Choose a benchmark: ";
+            cin >> benchmark;
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+            switch (benchmark) {
+            case 1:
+                benchmarkScanAllocations(cout, 100000);
+                break;
+            case 2:
+                benchmarkConcurrentHistory(cout, max(1, (int)thread::hardware_concurrency()), 2000);
+                break;
+            case 3:
+                benchmarkScanScaling(cout, 1000000, max(1, (int)thread::hardware_concurrency()));
+                break;
+            default:
+                cout << "Invalid benchmark." << endl;
+            }
+        }
+        break;
+
         default:
             cout << "Invalid option. Please try again." << endl;
         }
+
+        if (running && !journal.flushIfDue()) {
+            cout << "Could not save history." << endl;
+        }
     }
 
     return 0;
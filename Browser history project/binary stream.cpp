@@ -0,0 +1,192 @@
+#include "binary stream.h"
+#include <fstream>
+#include <cstdio>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+BinaryWriter::BinaryWriter(vector<char>& buffer)
+	: buffer(buffer)
+{
+}
+
+void BinaryWriter::writeU32(uint32_t value)
+{
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		buffer.push_back((char)(value >> shift));
+	}
+}
+
+void BinaryWriter::writeI32(int32_t value)
+{
+	writeU32((uint32_t)value);
+}
+
+void BinaryWriter::writeI64(int64_t value)
+{
+	writeU32((uint32_t)value);
+	writeU32((uint32_t)((uint64_t)value >> 32));
+}
+
+void BinaryWriter::writeString(const string& text)
+{
+	writeU32((uint32_t)text.size());
+	buffer.insert(buffer.end(), text.begin(), text.end());
+}
+
+BinaryReader::BinaryReader(const char* data, size_t length)
+	: position(data), end(data + length)
+{
+}
+
+bool BinaryReader::readU32(uint32_t& value)
+{
+	if (end - position < 4)
+	{
+		return false;
+	}
+	const unsigned char* bytes = (const unsigned char*)position;
+	value = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+	position += 4;
+	return true;
+}
+
+bool BinaryReader::readI32(int32_t& value)
+{
+	uint32_t raw;
+	if (!readU32(raw))
+	{
+		return false;
+	}
+	value = (int32_t)raw;
+	return true;
+}
+
+bool BinaryReader::readI64(int64_t& value)
+{
+	uint32_t low, high;
+	if (end - position < 8 || !readU32(low) || !readU32(high))
+	{
+		return false;
+	}
+	value = (int64_t)(((uint64_t)high << 32) | low);
+	return true;
+}
+
+bool BinaryReader::readString(string& text)
+{
+	uint32_t length;
+	if (end - position < 4)
+	{
+		return false;
+	}
+	readU32(length);
+	if ((size_t)(end - position) < length)
+	{
+		position -= 4;
+		return false;
+	}
+	text.assign(position, length);
+	position += length;
+	return true;
+}
+
+bool BinaryReader::atEnd() const
+{
+	return position == end;
+}
+
+size_t BinaryReader::remaining() const
+{
+	return (size_t)(end - position);
+}
+
+FILE* openFile(const string& path, const char* mode)
+{
+#ifdef _WIN32
+	FILE* file = nullptr;
+	return fopen_s(&file, path.c_str(), mode) == 0 ? file : nullptr;
+#else
+	return fopen(path.c_str(), mode);
+#endif
+}
+
+bool syncToDisk(FILE* file)
+{
+	if (fflush(file) != 0)
+	{
+		return false;
+	}
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+static bool replaceFile(const string& temporaryPath, const string& path)
+{
+#ifdef _WIN32
+	return MoveFileExW(filesystem::path(temporaryPath).c_str(), filesystem::path(path).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	if (rename(temporaryPath.c_str(), path.c_str()) != 0)
+	{
+		return false;
+	}
+	// The rename itself only survives a crash once the directory entry is on disk.
+	string directory = filesystem::path(path).parent_path().string();
+	int handle = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+	if (handle < 0)
+	{
+		return false;
+	}
+	bool synced = fsync(handle) == 0;
+	close(handle);
+	return synced;
+#endif
+}
+
+bool readWholeFile(const string& path, vector<char>& contents)
+{
+	ifstream file(path, ios::binary | ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+	streamsize length = file.tellg();
+	if (length < 0)
+	{
+		return false;
+	}
+	contents.resize((size_t)length);
+	file.seekg(0);
+	return length == 0 || (bool)file.read(contents.data(), length);
+}
+
+bool writeWholeFile(const string& path, const vector<char>& contents)
+{
+	string temporaryPath = path + ".tmp";
+	FILE* file = openFile(temporaryPath, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	bool written = fwrite(contents.data(), 1, contents.size(), file) == contents.size() && syncToDisk(file);
+	if (fclose(file) != 0 || !written)
+	{
+		remove(temporaryPath.c_str());
+		return false;
+	}
+	return replaceFile(temporaryPath, path);
+}
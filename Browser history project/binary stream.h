@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+
+using namespace std;
+
+// Little-endian encoding helpers for the history file formats.
+class BinaryWriter
+{
+private:
+	vector<char>& buffer;
+
+public:
+	BinaryWriter(vector<char>& buffer);
+
+	void writeU32(uint32_t value);
+	void writeI32(int32_t value);
+	void writeI64(int64_t value);
+	void writeString(const string& text);
+};
+
+// Reads from a borrowed buffer. Every read fails once the data runs out, leaving the value untouched.
+class BinaryReader
+{
+private:
+	const char* position;
+	const char* end;
+
+public:
+	BinaryReader(const char* data, size_t length);
+
+	bool readU32(uint32_t& value);
+	bool readI32(int32_t& value);
+	bool readI64(int64_t& value);
+	bool readString(string& text);
+	bool atEnd() const;
+	size_t remaining() const;
+};
+
+FILE* openFile(const string& path, const char* mode);
+// Flushes the stream and forces its data onto the disk.
+bool syncToDisk(FILE* file);
+
+bool readWholeFile(const string& path, vector<char>& contents);
+// Writes and syncs a temporary file, then swaps it in for path in one step, so a crash at any
+// point leaves either the old file or the new one complete on disk.
+bool writeWholeFile(const string& path, const vector<char>& contents);
@@ -1,14 +1,19 @@
 #include "browser history.h"
+#include "text search.h"
+#include "binary stream.h"
+#include "page traversal.h"
 #include <iostream>
 #include <algorithm>
 #include <ctime>
 #include <sstream>
 #include <iomanip>
 #include <stack>
+#include <unordered_set>
+#include <string_view>
 
 using namespace std;
 
-string extractDomain(const string& url)
+static string_view extractDomain(string_view url)
 {
 	size_t start = 0;
 	if (url.find("http://") == 0)
@@ -20,18 +25,52 @@ string extractDomain(const string& url)
 		start = 8;
 	}
 	size_t end = url.find('/', start);
-	if (end == string::npos)
+	if (end == string_view::npos)
 	{
 		end = url.length();
 	}
 	return url.substr(start, end - start);
 }
 
+static string reverseDomain(const string& domain)
+{
+	return string(domain.rbegin(), domain.rend());
+}
+
+bool PageAgeOrder::operator()(const Page* a, const Page* b) const
+{
+	if (a->getTimestamp() != b->getTimestamp())
+	{
+		return a->getTimestamp() < b->getTimestamp();
+	}
+	return a->getID() < b->getID();
+}
+
+bool PageAgeOrder::operator()(const Page* page, time_t timestamp) const
+{
+	return page->getTimestamp() < timestamp;
+}
+
+bool PageAgeOrder::operator()(time_t timestamp, const Page* page) const
+{
+	return timestamp < page->getTimestamp();
+}
+
+size_t ChildKeyHash::operator()(const ChildKey& key) const
+{
+	size_t parentHash = hash<const void*>()(key.first);
+	return parentHash ^ (hash<const void*>()(key.second) + 0x9e3779b9 + (parentHash << 6) + (parentHash >> 2));
+}
+
 BrowserHistory::BrowserHistory(int maxHistorySize)                                                
-	: root(nullptr), current(nullptr), size(0), maxSize(maxHistorySize), currentSessionID(generateSessionID()) {}
+	: root(nullptr), current(nullptr), size(0), maxSize(maxHistorySize), currentSessionID(nullptr), nextPageID(0), searchIndexEnabled(false), scanThreads(1), deferReclamation(false), batchDepth(0), batchTime(0), prunePending(false)
+{
+	currentSessionID = strings.intern(generateSessionID());
+}
 
 BrowserHistory::~BrowserHistory()                                               
 {
+	setDeferredReclamation(false);
 	clearHistory();
 }
 
@@ -47,94 +86,485 @@ void BrowserHistory::updatePrevExitTime()
 {
 	if (current != nullptr)
 	{
-		current->setExitTime(time(nullptr));
+		current->setExitTime(currentTime());
+		notifyPageUpdated(current);
 	}
 }
 void BrowserHistory::countPages(Page* page, int& count) const
 {
-	if (page == nullptr)
+	PageWalker::local().preOrder(page, [&](Page*, int)
 	{
-		return;
+		count++;
+		return true;
+	});
+}
+
+Page* BrowserHistory::createPage(Page* parent, const string& url, const string& title, time_t timestamp)
+{
+	return attachPage(parent, strings.intern(url), strings.intern(title), timestamp, strings.retain(currentSessionID), strings.intern(string(extractDomain(url))), nextPageID++);
+}
+
+PageBuckets BrowserHistory::bucketsFor(const InternedString* url, const InternedString* sessionID, const InternedString* host)
+{
+	return PageBuckets{ &urlIndex[url], &sessionIndex[sessionID], &domainIndex[reverseDomain(*host->text)] };
+}
+
+Page* BrowserHistory::attachPage(Page* parent, const InternedString* internedUrl, const InternedString* title, time_t timestamp, const InternedString* sessionID, const InternedString* host, unsigned int id)
+{
+	return attachPage(parent, internedUrl, title, timestamp, sessionID, host, id, bucketsFor(internedUrl, sessionID, host));
+}
+
+Page* BrowserHistory::attachPage(Page* parent, const InternedString* internedUrl, const InternedString* title, time_t timestamp, const InternedString* sessionID, const InternedString* host, unsigned int id, const PageBuckets& buckets)
+{
+	Page* page = pagePool.create(internedUrl, title, timestamp, sessionID, host);
+	if (parent != nullptr)
+	{
+		if (!evictionIndex.empty() && *evictionIndex.rbegin() == parent)
+		{
+			evictionIndex.erase(prev(evictionIndex.end()));
+		}
+		else
+		{
+			evictionIndex.erase(parent);
+		}
+		parent->addChild(page);
 	}
-	count++;
-	for (const auto& child : page->getChildren())
+	page->setID(id);
+	columns.add(page);
+	evictionIndex.insert(evictionIndex.end(), page);
+	buckets.sameUrl->insert(buckets.sameUrl->end(), page);
+	childIndex.emplace(ChildKey(parent, internedUrl), page);
+	orderIndex.append(page);
+	pageDirectory[page->getID()] = page;
+	timeIndex.insert(timeIndex.end(), page);
+	buckets.sameSession->insert(buckets.sameSession->end(), page);
+	buckets.sameDomain->insert(buckets.sameDomain->end(), page);
+	if (searchIndexEnabled)
 	{
-		countPages(child, count);
+		titleTrigrams.add(page->getID(), page->getInternedTitle()->lower());
+		urlTrigrams.add(page->getID(), internedUrl->lower());
 	}
+	size++;
+	for (HistoryObserver* observer : observers)
+	{
+		if (deliversTo(observer))
+		{
+			observer->onPageAdded(page);
+		}
+	}
+	return page;
 }
 
-void BrowserHistory::pruneOldestPages()
+void BrowserHistory::removePage(Page* page)
 {
-	while (size <= maxSize && root == nullptr)
+	notifyPageRemoving(page);
+
+	// Children are left before their parent, so each page is freed as soon as it is unindexed. The
+	// subtree's root goes last, once it is off its parent's child list.
+	PageWalker::local().postOrder(page, [&](Page* removed)
 	{
-		return;
+		unindexPage(removed);
+		if (removed != page)
+		{
+			retirePage(removed);
+		}
+		return true;
+	});
+
+	Page* parent = page->getParent();
+	if (parent)
+	{
+		parent->removeChild(page);
+		if (parent->getChildren().empty())
+		{
+			evictionIndex.insert(parent);
+		}
 	}
-	vector<Page*> allPages;
-	collectAllPages(root, allPages);
-	sort(allPages.begin(), allPages.end(), [](Page* a, Page* b) {return a->getTimestamp() < b->getTimestamp(); });
-	int pagesToRemove = size - maxSize;
-	vector<Page*> pathToCurrent;
-	for (Page* p = current; p != nullptr; p = p->getParent())
+	retirePage(page);
+	if (titleTrigrams.needsRebuild() || urlTrigrams.needsRebuild())
 	{
-		pathToCurrent.push_back(p);
+		rebuildSearchIndex();
 	}
-	for (Page* page : allPages)
+}
+
+void BrowserHistory::unindexPage(Page* removed)
+{
+	evictionIndex.erase(removed);
+	orderIndex.remove(removed);
+	columns.remove(removed->getColumnSlot());
+	pageDirectory.erase(removed->getID());
+	timeIndex.erase(removed);
+	auto session = sessionIndex.find(removed->getInternedSessionID());
+	if (session != sessionIndex.end())
 	{
-		if (pagesToRemove <= 0)
+		session->second.erase(removed);
+		if (session->second.empty())
 		{
+			sessionIndex.erase(session);
+		}
+	}
+	auto domain = domainIndex.find(reverseDomain(removed->getHost()));
+	if (domain != domainIndex.end())
+	{
+		domain->second.erase(removed);
+		if (domain->second.empty())
+		{
+			domainIndex.erase(domain);
+		}
+	}
+	if (searchIndexEnabled)
+	{
+		titleTrigrams.remove(removed->getInternedTitle()->lower());
+		urlTrigrams.remove(removed->getInternedUrl()->lower());
+	}
+	auto bucket = urlIndex.find(removed->getInternedUrl());
+	if (bucket != urlIndex.end())
+	{
+		bucket->second.erase(removed);
+		if (bucket->second.empty())
+		{
+			urlIndex.erase(bucket);
+		}
+	}
+	auto siblings = childIndex.equal_range(ChildKey(removed->getParent(), removed->getInternedUrl()));
+	for (auto sibling = siblings.first; sibling != siblings.second; ++sibling)
+	{
+		if (sibling->second == removed)
+		{
+			childIndex.erase(sibling);
 			break;
 		}
-		if (page == root || find(pathToCurrent.begin(), pathToCurrent.end(), page) != pathToCurrent.end())
+	}
+	size--;
+}
+
+void BrowserHistory::retirePage(Page* page)
+{
+	if (deferReclamation)
+	{
+		retiredPages.push_back(page);
+	}
+	else
+	{
+		reclaimPage(page);
+	}
+}
+
+void BrowserHistory::reclaimPage(Page* page)
+{
+	strings.release(page->getInternedUrl());
+	strings.release(page->getInternedTitle());
+	strings.release(page->getInternedSessionID());
+	strings.release(page->getInternedHost());
+	pagePool.destroy(page);
+}
+
+void BrowserHistory::reclaimPages(const vector<Page*>& pages)
+{
+	for (Page* page : pages)
+	{
+		reclaimPage(page);
+	}
+}
+
+void BrowserHistory::setDeferredReclamation(bool enabled)
+{
+	deferReclamation = enabled;
+	if (!enabled)
+	{
+		reclaimPages(retiredPages);
+		retiredPages.clear();
+	}
+}
+
+void BrowserHistory::takeRetiredPages(vector<Page*>& pages)
+{
+	pages.insert(pages.end(), retiredPages.begin(), retiredPages.end());
+	retiredPages.clear();
+}
+
+void BrowserHistory::pinPage(Page* page)
+{
+	if (page != nullptr)
+	{
+		pinnedPages[page]++;
+	}
+}
+
+void BrowserHistory::unpinPage(Page* page)
+{
+	auto pinned = pinnedPages.find(page);
+	if (pinned != pinnedPages.end() && --pinned->second == 0)
+	{
+		pinnedPages.erase(pinned);
+	}
+}
+
+bool BrowserHistory::isPinned(Page* page) const
+{
+	return pinnedPages.count(page) != 0;
+}
+
+void BrowserHistory::rebuildSearchIndex()
+{
+	titleTrigrams.clear();
+	urlTrigrams.clear();
+	if (!searchIndexEnabled)
+	{
+		return;
+	}
+	vector<Page*> pages;
+	orderIndex.collect(pages);
+	for (Page* page : pages)
+	{
+		titleTrigrams.add(page->getID(), page->getInternedTitle()->lower());
+		urlTrigrams.add(page->getID(), page->getInternedUrl()->lower());
+	}
+}
+
+bool BrowserHistory::searchIndexCandidates(const TrigramIndex& index, const string& foldedPattern, vector<Page*>& pages) const
+{
+	vector<unsigned int> ids;
+	if (!searchIndexEnabled || !index.lookup(foldedPattern, ids))
+	{
+		return false;
+	}
+	for (unsigned int id : ids)
+	{
+		auto it = pageDirectory.find(id);
+		if (it != pageDirectory.end())
+		{
+			pages.push_back(it->second);
+		}
+	}
+	return true;
+}
+
+Page* BrowserHistory::oldestEvictablePage() const
+{
+	for (Page* page : evictionIndex)
+	{
+		if (page != root && page != current && pinnedPages.count(page) == 0)
 		{
-			continue;
+			return page;
 		}
-		Page* parent = page->getParent();
-		if (parent)
+	}
+	return nullptr;
+}
+
+bool BrowserHistory::leadsToPinnedPage(Page* page) const
+{
+	for (const auto& pinned : pinnedPages)
+	{
+		for (Page* ancestor = pinned.first; ancestor != nullptr; ancestor = ancestor->getParent())
 		{
-			parent->removeChild(page);
-			size--;
-			pagesToRemove--;
+			if (ancestor == page)
+			{
+				return true;
+			}
 		}
 	}
+	return false;
 }
 
-void BrowserHistory::collectAllPages(Page* page, vector<Page*>& pages) const
+Page* BrowserHistory::findChildByURL(Page* parent, const InternedString* url) const
+{
+	auto child = childIndex.find(ChildKey(parent, url));
+	return child != childIndex.end() ? child->second : nullptr;
+}
+
+void BrowserHistory::setCurrent(Page* page)
 {
-	if (page == nullptr) 
+	if (page == current)
 	{
 		return;
 	}
-	pages.push_back(page);
-	for (const auto& child : page->getChildren())
+	Page* previous = current;
+	current = page;
+	for (HistoryObserver* observer : observers)
 	{
-		collectAllPages(child, pages);
+		if (deliversTo(observer))
+		{
+			observer->onCurrentPageChanged(previous, current);
+		}
 	}
+}
 
+void BrowserHistory::notifyPageUpdated(Page* page)
+{
+	for (HistoryObserver* observer : observers)
+	{
+		if (deliversTo(observer))
+		{
+			observer->onPageUpdated(page);
+		}
+	}
+}
+
+void BrowserHistory::notifyPageRemoving(Page* page)
+{
+	for (HistoryObserver* observer : observers)
+	{
+		if (deliversTo(observer))
+		{
+			observer->onPageRemoving(page);
+		}
+	}
+}
+
+bool BrowserHistory::deliversTo(const HistoryObserver* observer) const
+{
+	return batchDepth == 0 || observer->wantsBatchedEvents();
+}
+
+time_t BrowserHistory::currentTime() const
+{
+	return batchDepth > 0 ? batchTime : time(nullptr);
+}
+
+void BrowserHistory::beginBatch()
+{
+	if (batchDepth++ == 0)
+	{
+		batchTime = time(nullptr);
+	}
+}
+
+void BrowserHistory::endBatch()
+{
+	if (batchDepth > 1)
+	{
+		batchDepth--;
+		return;
+	}
+	if (prunePending)
+	{
+		prunePending = false;
+		evictOverflow();
+	}
+	batchDepth = 0;
+	for (HistoryObserver* observer : observers)
+	{
+		observer->onBatchCommitted();
+	}
+}
+
+BrowserHistory::Batch::Batch(BrowserHistory& history)
+	: history(&history)
+{
+	history.beginBatch();
+}
+
+BrowserHistory::Batch::~Batch()
+{
+	commit();
+}
+
+void BrowserHistory::Batch::commit()
+{
+	if (history != nullptr)
+	{
+		history->endBatch();
+		history = nullptr;
+	}
+}
+
+void BrowserHistory::pruneOldestPages()
+{
+	if (batchDepth > 0)
+	{
+		prunePending = true;
+		return;
+	}
+	evictOverflow();
+}
+
+void BrowserHistory::evictOverflow()
+{
+	// Evicted leaves leave the indexes one at a time but their parents' child lists once at the end,
+	// so evicting many children of one page costs a single pass over its children.
+	vector<Page*> evicted;
+	unordered_set<Page*> evictedSet;
+	unordered_map<Page*, size_t> liveChildren;
+	while (size > maxSize)
+	{
+		Page* oldest = oldestEvictablePage();
+		if (oldest == nullptr)
+		{
+			break;
+		}
+		notifyPageRemoving(oldest);
+		unindexPage(oldest);
+		evicted.push_back(oldest);
+		evictedSet.insert(oldest);
+		Page* parent = oldest->getParent();
+		if (parent != nullptr)
+		{
+			auto children = liveChildren.try_emplace(parent, parent->getChildren().size()).first;
+			if (--children->second == 0)
+			{
+				evictionIndex.insert(parent);
+			}
+		}
+	}
+	if (evicted.empty())
+	{
+		return;
+	}
+
+	for (const auto& children : liveChildren)
+	{
+		Page* parent = children.first;
+		if (evictedSet.count(parent) == 0)
+		{
+			parent->removeChildren(evictedSet);
+		}
+	}
+	for (Page* page : evicted)
+	{
+		retirePage(page);
+	}
+	if (titleTrigrams.needsRebuild() || urlTrigrams.needsRebuild())
+	{
+		rebuildSearchIndex();
+	}
+}
+
+void BrowserHistory::collectAllPages(Page* page, vector<Page*>& pages) const
+{
+	PageWalker::local().preOrder(page, [&](Page* visited, int)
+	{
+		pages.push_back(visited);
+		return true;
+	});
 }
 
 vector <Page*> BrowserHistory::findPagesByDomain(const string& domain) const
 {
 	vector<Page*> results;
-	vector<Page*> allPages;
-	collectAllPages(root, allPages);
-	for (Page* page : allPages)
+	bool withSubdomains = domain.compare(0, 2, "*.") == 0;
+	string key = reverseDomain(withSubdomains ? domain.substr(2) : domain);
+
+	auto exact = domainIndex.find(key);
+	if (exact != domainIndex.end())
 	{
-		string pageDomain = extractDomain(page->getUrl());
-		if (pageDomain == domain)
+		results.assign(exact->second.begin(), exact->second.end());
+	}
+	if (withSubdomains)
+	{
+		string prefix = key + ".";
+		for (auto it = domainIndex.lower_bound(prefix); it != domainIndex.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
 		{
-			results.push_back(page);
+			results.insert(results.end(), it->second.begin(), it->second.end());
 		}
+		sort(results.begin(), results.end(), PageAgeOrder());
 	}
 	return results;
 }
 
 bool BrowserHistory::containsSubstring(const string& str, const string& substring) const
 {
-	string strLower = str;
-	string substringLower = substring;
-	transform(strLower.begin(), strLower.end(), strLower.begin(), ::tolower);
-	transform(substringLower.begin(), substringLower.end(), substringLower.begin(), ::tolower);
-	return strLower.find(substringLower) != string::npos;
+	return containsIgnoreCase(str, substring);
 }
 
 vector<Page*> BrowserHistory::findPagesByTitle(const string& titleSubstring) const
@@ -145,12 +575,20 @@ vector<Page*> BrowserHistory::findPagesByTitle(const string& titleSubstring) con
 		return results;
 	}
 
-	vector<Page*> allPages;
-	collectAllPages(root, allPages);
+	const string needle = foldCase(titleSubstring);
+	vector<Page*> candidates;
+	if (searchIndexCandidates(titleTrigrams, needle, candidates))
+	{
+		sort(candidates.begin(), candidates.end(), PageAgeOrder());
+	}
+	else
+	{
+		candidates.assign(timeIndex.begin(), timeIndex.end());
+	}
 
-	for (Page* page : allPages)
+	for (Page* page : candidates)
 	{
-		if (containsSubstring(page->getTitle(), titleSubstring))
+		if (containsFolded(page->getInternedTitle()->lower(), needle))
 		{
 			results.push_back(page);
 		}
@@ -165,30 +603,92 @@ bool BrowserHistory::goToTitle(const string& titleSubstring)
 	if (!matchingPages.empty())
 	{
 		updatePrevExitTime();
-		current = matchingPages[0];
+		setCurrent(matchingPages[0]);
 		return true;
 	}
 	return false;
 }
 
-vector<Page*> BrowserHistory::searchPages(const string& titleSubstring, const string& urlSubstring, const string& sessionID, time_t startTime, time_t endTime) const
+vector<Page*> BrowserHistory::searchPages(const string& titleSubstring, const string& urlSubstring, const string& sessionID, time_t startTime, time_t endTime, const atomic<bool>* cancelled) const
 {
 	vector<Page*> results;
-	vector<Page*> allPages;
-	collectAllPages(root, allPages);
+	const InternedString* session = nullptr;
+	if (!sessionID.empty())
+	{
+		session = strings.find(sessionID);
+		if (session == nullptr)
+		{
+			return results;
+		}
+	}
+
+	const string titleNeedle = foldCase(titleSubstring);
+	const string urlNeedle = foldCase(urlSubstring);
+	if (startTime > 0 && endTime > 0 && startTime > endTime)
+	{
+		return results;
+	}
+
+	const PageTimeline* timeline = &timeIndex;
+	if (session != nullptr)
+	{
+		auto bucket = sessionIndex.find(session);
+		if (bucket == sessionIndex.end())
+		{
+			return results;
+		}
+		timeline = &bucket->second;
+	}
 
-	for (Page* page : allPages)
+	vector<Page*> candidates;
+	bool indexed = searchIndexCandidates(titleTrigrams, titleNeedle, candidates) || searchIndexCandidates(urlTrigrams, urlNeedle, candidates);
+	if (indexed && (session == nullptr || candidates.size() <= timeline->size()))
+	{
+		sort(candidates.begin(), candidates.end(), PageAgeOrder());
+	}
+	else if ((!titleNeedle.empty() || !urlNeedle.empty()) && (session == nullptr || timeline->size() * 2 > (size_t)size))
 	{
+		// Unindexed text filters test every page in the timeline. When that is most of the history,
+		// scanning the dense columns beats walking the set, and only the matches need sorting.
+		vector<uint32_t> slots;
+		bool completed = columns.scan(startTime, endTime, [&](uint32_t slot)
+		{
+			return (session == nullptr || columns.sessionAt(slot) == session)
+				&& (titleNeedle.empty() || containsFolded(columns.titleAt(slot)->lower(), titleNeedle))
+				&& (urlNeedle.empty() || containsFolded(columns.urlAt(slot)->lower(), urlNeedle));
+		}, slots, cancelled, scanThreads);
+		if (completed)
+		{
+			columns.sortByAge(slots);
+			columns.collect(slots, results);
+		}
+		return results;
+	}
+	else
+	{
+		auto first = startTime > 0 ? timeline->lower_bound(startTime) : timeline->begin();
+		auto last = endTime > 0 ? timeline->upper_bound(endTime) : timeline->end();
+		candidates.assign(first, last);
+	}
+
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		if (cancelled != nullptr && (i & 1023) == 0 && cancelled->load())
+		{
+			results.clear();
+			return results;
+		}
+		Page* page = candidates[i];
 		bool match = true;
-		if (!titleSubstring.empty() && !containsSubstring(page->getTitle(), titleSubstring))
+		if (!titleNeedle.empty() && !containsFolded(page->getInternedTitle()->lower(), titleNeedle))
 		{
 			match = false;
 		}
-		if (match && !urlSubstring.empty() && !containsSubstring(page->getUrl(), urlSubstring))
+		if (match && !urlNeedle.empty() && !containsFolded(page->getInternedUrl()->lower(), urlNeedle))
 		{
 			match = false;
 		}
-		if (match && !sessionID.empty() && page->getSessionID() != sessionID)
+		if (match && session != nullptr && page->getInternedSessionID() != session)
 		{
 			match = false;
 		}
@@ -215,10 +715,11 @@ void BrowserHistory::addPage(const string& url, const string& title)
 {
 	updatePrevExitTime();
 
-	Page* newPage = new Page(url, title, time(nullptr), currentSessionID);                        
+	time_t now = currentTime();
 	if (root == nullptr)                                                        
 	{
-		root = current = new Page(url, title, time(nullptr), currentSessionID);                                        
+		root = createPage(nullptr, url, title, now);
+		setCurrent(root);
 	}
 	else
 	{
@@ -227,13 +728,15 @@ void BrowserHistory::addPage(const string& url, const string& title)
 			vector<Page*> children = current->getChildren();
 			for (Page* child : children)
 			{
-				current->removeChild(child);
+				if (!leadsToPinnedPage(child))
+				{
+					removePage(child);
+				}
 			}
 		}
 
-		current = current->addChild(url, title, time(nullptr), currentSessionID);
+		setCurrent(createPage(current, url, title, now));
 	}
-	size++; 		
 
 	pruneOldestPages();
 }
@@ -243,21 +746,21 @@ void BrowserHistory::visit(const string& url, const string& title)
 	updatePrevExitTime();
 	if (root == nullptr)
 	{
-		root = current = new Page(url, title, time(nullptr), currentSessionID);
+		root = createPage(nullptr, url, title, currentTime());
+		setCurrent(root);
 	}
 	else
 	{
-		Page* existingChild = current->findChild(url);
+		Page* existingChild = findChildByURL(current, strings.find(url));
 		if (existingChild)
 		{
-			current = existingChild;
+			setCurrent(existingChild);
 		}
 		else
 		{
-			current = current->addChild(url, title, time(nullptr), currentSessionID);
+			setCurrent(createPage(current, url, title, currentTime()));
 		}
 	}
-	size++;
 	pruneOldestPages();
 }
 
@@ -275,7 +778,7 @@ bool BrowserHistory::goBack()
 {
 	if (canGoBack()) 
 	{
-		current = current->getParent();
+		setCurrent(current->getParent());
 		return true;  
 	}
 	else
@@ -288,7 +791,7 @@ bool BrowserHistory::goForward()
 {
 	if(canGoForward()) 
 	{
-		current = current->getChildren()[0];
+		setCurrent(current->getChildren()[0]);
 		return true;
 	}
 	else
@@ -310,7 +813,7 @@ bool BrowserHistory::goBack(int steps)
 			return(i > 0);
 		}
 		updatePrevExitTime();
-		current = current->getPrev();
+		setCurrent(current->getPrev());
 	}
 	return true;
 }
@@ -323,7 +826,7 @@ bool BrowserHistory::forward(int branchIndex)
 		if (branchIndex >= 0 && branchIndex < children.size())
 		{
 			updatePrevExitTime();
-			current = children[branchIndex];
+			setCurrent(children[branchIndex]);
 			return true;
 		}
 	}
@@ -343,71 +846,78 @@ bool BrowserHistory::goForward(int steps)
 			return(i > 0);
 		}
 		updatePrevExitTime();
-		current = current->getNext();
+		setCurrent(current->getNext());
 	}
 	return true;
 }
 
 bool BrowserHistory::goToIndex(int index)
 {
-	if (index < 0 || index >= size)
+	Page* page = orderIndex.pageAt(index);
+	if (page == nullptr)
 	{
 		return false;
 	}
-	vector<Page*> orderedPages;
-	vector<Page*> queue = { root };
-	while (!queue.empty())
-	{
-		Page* current = queue.front();
-		queue.erase(queue.begin());
-		orderedPages.push_back(current);
-		for (Page* child : current->getChildren())
-		{
-			queue.push_back(child);
-		}
-	}
-	if (index < orderedPages.size())
-	{
-		updatePrevExitTime();
-		current = orderedPages[index];
-		return true;
-	}
-	return false;
+	updatePrevExitTime();
+	setCurrent(page);
+	return true;
 }
 
 bool BrowserHistory::goToURL(const string& url) 
 {
-	vector<Page*> path;
-	if (findPageInTree(root, url, path) && !path.empty())
+	auto bucket = urlIndex.find(strings.find(url));
+	if (bucket == urlIndex.end())
 	{
-		updatePrevExitTime();
-		current = path.back();
-		return true;
+		return false;
 	}
-
-	return false;
+	updatePrevExitTime();
+	setCurrent(*bucket->second.begin());
+	return true;
 }
 
-bool BrowserHistory::findPageInTree(Page* root, const string& url, vector<Page*>& path) const
+bool BrowserHistory::goToPage(Page* page)
 {
-	if (root == nullptr) 
+	if (page == nullptr || findPageByID(page->getID()) != page)
 	{
 		return false;
 	}
-	path.push_back(root);
-	if (root->getUrl() == url)
+	if (page != current)
 	{
-		return true;
+		updatePrevExitTime();
+		setCurrent(page);
 	}
-	for (Page* child : root->getChildren())
+	return true;
+}
+
+bool BrowserHistory::goToPageID(unsigned int id)
+{
+	return goToPage(findPageByID(id));
+}
+
+bool BrowserHistory::findPageInTree(Page* root, const string& url, vector<Page*>& path) const
+{
+	Page* match = nullptr;
+	PageWalker::local().preOrder(root, [&](Page* page, int)
 	{
-		if (findPageInTree(child, url, path))
+		if (page->getUrl() == url)
 		{
-			return true;
+			match = page;
+			return false;
 		}
+		return true;
+	});
+	if (match == nullptr)
+	{
+		return false;
 	}
-	path.pop_back();
-	return false;
+	size_t start = path.size();
+	for (Page* page = match; page != root; page = page->getParent())
+	{
+		path.push_back(page);
+	}
+	path.push_back(root);
+	reverse(path.begin() + start, path.end());
+	return true;
 }
 
 bool BrowserHistory::goToHome()
@@ -417,7 +927,7 @@ bool BrowserHistory::goToHome()
 		return false;
 	}
 	updatePrevExitTime();
-	current = root;
+	setCurrent(root);
 	return true;
 }
 
@@ -427,25 +937,10 @@ bool BrowserHistory::goToEnd()
 	{
 		return false;
 	}
-	vector<Page*> allPages;
-	collectAllPages(root, allPages);
-	Page* mostRecent = nullptr;
-	time_t latestTime = 0;
-	for (Page* page : allPages)
-	{
-		if (page->getChildren().empty() && page->getTimestamp() > latestTime)
-		{
-			mostRecent = page;
-			latestTime = page->getTimestamp();
-		}
-	}
-	if (mostRecent)
-	{
-		updatePrevExitTime();
-		current = mostRecent;
-		return true;
-	}
-	return false;
+	// Every childless page is in the eviction index, newest last.
+	updatePrevExitTime();
+	setCurrent(*evictionIndex.rbegin());
+	return true;
 }
 
 void BrowserHistory::refresh()
@@ -462,6 +957,7 @@ void BrowserHistory::setScrollPosition(int position)
 	if (current != nullptr)
 	{
 		current->setScrollPosition(position);
+		notifyPageUpdated(current);
 	}
 }
 
@@ -470,12 +966,43 @@ void BrowserHistory::addFormData(string& key, string& value)
 	if (current != nullptr)
 	{
 		current->setFormData(key, value);
+		notifyPageUpdated(current);
 	}
 }
 
 void BrowserHistory::startNewSession()
 {
-	currentSessionID = generateSessionID();
+	strings.release(currentSessionID);
+	currentSessionID = strings.intern(generateSessionID());
+}
+
+void BrowserHistory::setSearchIndexEnabled(bool enabled)
+{
+	if (enabled == searchIndexEnabled)
+	{
+		return;
+	}
+	searchIndexEnabled = enabled;
+	rebuildSearchIndex();
+}
+
+bool BrowserHistory::isSearchIndexEnabled() const
+{
+	return searchIndexEnabled;
+}
+
+void BrowserHistory::setScanThreads(unsigned int threads)
+{
+	if (threads == 0)
+	{
+		threads = max(1u, thread::hardware_concurrency());
+	}
+	scanThreads = threads;
+}
+
+unsigned int BrowserHistory::getScanThreads() const
+{
+	return scanThreads;
 }
 
 void BrowserHistory::setMaxSize(int newMaxSize)
@@ -486,6 +1013,31 @@ void BrowserHistory::setMaxSize(int newMaxSize)
 	}
 	maxSize = newMaxSize;
 	pruneOldestPages();
+	for (HistoryObserver* observer : observers)
+	{
+		if (deliversTo(observer))
+		{
+			observer->onMaxSizeChanged(maxSize);
+		}
+	}
+}
+
+void BrowserHistory::addObserver(HistoryObserver* observer)
+{
+	if (observer != nullptr && find(observers.begin(), observers.end(), observer) == observers.end())
+	{
+		observers.push_back(observer);
+	}
+}
+
+void BrowserHistory::removeObserver(HistoryObserver* observer)
+{
+	observers.erase(remove(observers.begin(), observers.end(), observer), observers.end());
+}
+
+Page* BrowserHistory::getRootPage() const
+{
+	return root;
 }
 
 Page* BrowserHistory::getCurrentPage() const
@@ -494,6 +1046,12 @@ Page* BrowserHistory::getCurrentPage() const
 
 }
 
+Page* BrowserHistory::findPageByID(unsigned int id) const
+{
+	auto it = pageDirectory.find(id);
+	return it == pageDirectory.end() ? nullptr : it->second;
+}
+
 int BrowserHistory::getSize() const
 {
 	return size;
@@ -510,28 +1068,12 @@ int BrowserHistory::getCurrentIndex() const
 	{
 		return -1;
 	}
-	vector<Page*> queue = { root }; 
-	int index = 0;
-	while (!queue.empty())
-	{
-		Page* page = queue.front();
-		queue.erase(queue.begin());
-		if (page == current)
-		{
-			return index;
-		}
-		index++;
-		for (Page* child : page->getChildren())
-		{
-			queue.push_back(child);
-		}
-	}
-	return -1;
+	return orderIndex.indexOf(current);
 }
 
-string BrowserHistory::getCurrentSessionID() const
+const string& BrowserHistory::getCurrentSessionID() const
 {
-	return currentSessionID;
+	return *currentSessionID->text;
 }
 
 int BrowserHistory::branchCount() const
@@ -593,15 +1135,15 @@ void::BrowserHistory::printHistoryTree() const
 		return;
 	}
 	cout << "History tree: " << endl;
-	printPage(root, 0);
+	PageWalker::local().preOrder(root, [&](Page* page, int depth)
+	{
+		printPage(page, depth);
+		return true;
+	});
 }
 
 void BrowserHistory::printPage(const Page* page, int level) const
 {
-	if (page == nullptr)
-	{
-		return;
-	}
 	string indent(level * 2, ' ');
 	cout << indent << "_ " << page->getTitle();
 	if (page == current)
@@ -610,54 +1152,343 @@ void BrowserHistory::printPage(const Page* page, int level) const
 	}
 	cout << endl;
 	cout << indent << " " << page->getUrl() << endl;
-	for (const Page* child : page->getChildren())
+}
+
+void BrowserHistory::clearHistory(time_t olderThan)
+{
+	while (root != nullptr)
 	{
-		printPage(child, level + 1);
+		Page* oldest = oldestEvictablePage();
+		if (oldest == nullptr || oldest->getTimestamp() >= olderThan)
+		{
+			break;
+		}
+		removePage(oldest);
 	}
 }
 
-void BrowserHistory::clearHistory(time_t olderThan)
+void BrowserHistory::clearHistory()
 {
-	if (root == nullptr)
+	if (deferReclamation)
 	{
-		return;
+		orderIndex.collect(retiredPages);
+	}
+	else
+	{
+		pagePool.reset();
+		string sessionID = *currentSessionID->text;
+		strings.clear();
+		currentSessionID = strings.intern(sessionID);
 	}
-	vector<Page*> allPages;
-	collectAllPages(root, allPages);
+	root = nullptr;
+	evictionIndex.clear();
+	urlIndex.clear();
+	childIndex.clear();
+	orderIndex.clear();
+	columns.clear();
+	pageDirectory.clear();
+	timeIndex.clear();
+	sessionIndex.clear();
+	domainIndex.clear();
+	titleTrigrams.clear();
+	urlTrigrams.clear();
+	pinnedPages.clear();
+	size = 0;
+	current = nullptr;
+	for (HistoryObserver* observer : observers)
+	{
+		if (deliversTo(observer))
+		{
+			observer->onHistoryCleared();
+		}
+	}
+}
+
+static const uint32_t historyFileMagic = 0x54534842;
+static const uint32_t historyFileVersion = 2;
 
-	sort(allPages.begin(), allPages.end(), [](Page* a, Page* b) {return a->getTimestamp() < b->getTimestamp(); });
-	vector<Page*> pathToCurrent;
-	for (Page* p = current; p != nullptr; p = p->getParent())
+struct HistoryFileRecord
+{
+	uint32_t id;
+	int32_t parent;
+	uint32_t url;
+	uint32_t title;
+	uint32_t sessionID;
+	int64_t timestamp;
+	int64_t exitTime;
+	int32_t scrollPosition;
+	uint32_t firstFormField;
+	uint32_t formFieldCount;
+};
+
+bool BrowserHistory::saveToFile(const string& path) const
+{
+	vector<Page*> pages;
+	orderIndex.collect(pages);
+
+	unordered_map<string, uint32_t> stringIndex;
+	vector<const string*> stringTable;
+	auto stringID = [&](const string& text)
 	{
-		pathToCurrent.push_back(p);
+		auto entry = stringIndex.emplace(text, (uint32_t)stringTable.size());
+		if (entry.second)
+		{
+			stringTable.push_back(&entry.first->first);
+		}
+		return entry.first->second;
+	};
+
+	unordered_map<const Page*, int32_t> recordIndex;
+	recordIndex.reserve(pages.size());
+	vector<char> records;
+	BinaryWriter recordWriter(records);
+	for (Page* page : pages)
+	{
+		recordIndex[page] = (int32_t)recordIndex.size();
+		recordWriter.writeU32(page->getID());
+		recordWriter.writeI32(page->getParent() ? recordIndex.at(page->getParent()) : -1);
+		recordWriter.writeU32(stringID(page->getUrl()));
+		recordWriter.writeU32(stringID(page->getTitle()));
+		recordWriter.writeU32(stringID(page->getSessionID()));
+		recordWriter.writeI64((int64_t)page->getTimestamp());
+		recordWriter.writeI64((int64_t)page->getExitTime());
+		recordWriter.writeI32(page->getScrollPosition());
+		recordWriter.writeU32((uint32_t)page->getFormData().size());
+		for (const auto& field : page->getFormData())
+		{
+			recordWriter.writeU32(stringID(field.first));
+			recordWriter.writeU32(stringID(field.second));
+		}
+	}
+
+	vector<char> contents;
+	BinaryWriter writer(contents);
+	writer.writeU32(historyFileMagic);
+	writer.writeU32(historyFileVersion);
+	writer.writeI32(maxSize);
+	writer.writeI32(current ? recordIndex.at(current) : -1);
+	writer.writeU32((uint32_t)stringTable.size());
+	writer.writeU32((uint32_t)pages.size());
+	for (const string* text : stringTable)
+	{
+		writer.writeString(*text);
+	}
+	contents.insert(contents.end(), records.begin(), records.end());
+	return writeWholeFile(path, contents);
+}
+
+bool BrowserHistory::loadFromFile(const string& path)
+{
+	vector<char> contents;
+	if (!readWholeFile(path, contents))
+	{
+		return false;
+	}
+	BinaryReader reader(contents.data(), contents.size());
+
+	uint32_t magic, version, stringCount, pageCount;
+	int32_t savedMaxSize, currentRecord;
+	if (!reader.readU32(magic) || magic != historyFileMagic || !reader.readU32(version) || version < 1 || version > historyFileVersion
+		|| !reader.readI32(savedMaxSize) || !reader.readI32(currentRecord) || !reader.readU32(stringCount) || !reader.readU32(pageCount))
+	{
+		return false;
+	}
+	if (savedMaxSize < 1 || stringCount > contents.size() / 4 || pageCount > contents.size() / 40
+		|| currentRecord >= (int64_t)pageCount || (currentRecord < 0) != (pageCount == 0))
+	{
+		return false;
 	}
-	for (Page* page : allPages)
+
+	vector<string> table(stringCount);
+	for (string& text : table)
 	{
-		if (page->getTimestamp() >= olderThan)
+		if (!reader.readString(text))
 		{
-			break;
+			return false;
 		}
-		if (page == root || find(pathToCurrent.begin(), pathToCurrent.end(), page) != pathToCurrent.end())
+	}
+
+	vector<HistoryFileRecord> records(pageCount);
+	vector<uint32_t> formFields;
+	vector<uint32_t> ids;
+	ids.reserve(pageCount);
+	for (uint32_t index = 0; index < pageCount; index++)
+	{
+		HistoryFileRecord& record = records[index];
+		record.id = index;
+		if (version >= 2 && !reader.readU32(record.id))
+		{
+			return false;
+		}
+		ids.push_back(record.id);
+		int64_t timestamp, exitTime;
+		if (!reader.readI32(record.parent) || !reader.readU32(record.url) || !reader.readU32(record.title) || !reader.readU32(record.sessionID)
+			|| !reader.readI64(timestamp) || !reader.readI64(exitTime) || !reader.readI32(record.scrollPosition) || !reader.readU32(record.formFieldCount))
 		{
-			continue;
+			return false;
 		}
-		Page* parent = page->getParent();
-		if (parent)
+		if (record.parent >= (int64_t)index || (record.parent < 0) != (index == 0)
+			|| record.url >= stringCount || record.title >= stringCount || record.sessionID >= stringCount
+			|| record.formFieldCount > reader.remaining() / 8)
 		{
-			parent->removeChild(page);
-			size--;
+			return false;
+		}
+		record.timestamp = timestamp;
+		record.exitTime = exitTime;
+		record.firstFormField = (uint32_t)formFields.size();
+		for (size_t field = 0; field < (size_t)record.formFieldCount * 2; field++)
+		{
+			uint32_t text;
+			if (!reader.readU32(text) || text >= stringCount)
+			{
+				return false;
+			}
+			formFields.push_back(text);
 		}
 	}
+	if (!reader.atEnd())
+	{
+		return false;
+	}
+	// Sorting once finds a repeated id far faster than hashing every id as it is read.
+	sort(ids.begin(), ids.end());
+	if (adjacent_find(ids.begin(), ids.end()) != ids.end())
+	{
+		return false;
+	}
+	vector<uint32_t>().swap(ids);
+
+	clearHistory();
+	maxSize = savedMaxSize;
+	strings.reserve(stringCount * 2);
+	pageDirectory.reserve(pageCount);
+	columns.reserve(pageCount);
+	urlIndex.reserve(pageCount);
+	childIndex.reserve(pageCount);
+	vector<const InternedString*> interned(stringCount);
+	for (uint32_t index = 0; index < stringCount; index++)
+	{
+		interned[index] = strings.intern(move(table[index]));
+	}
+	// Hosts, and the index buckets a page is filed under, are worked out once per distinct string.
+	vector<const InternedString*> hosts(stringCount, nullptr);
+	unordered_map<string_view, pair<const InternedString*, PageTimeline*>> hostsByName;
+	vector<PageTimeline*> urlBuckets(stringCount, nullptr);
+	vector<PageTimeline*> domainBuckets(stringCount, nullptr);
+	vector<PageTimeline*> sessionBuckets(stringCount, nullptr);
+	vector<Page*> loaded(pageCount);
+	for (uint32_t index = 0; index < pageCount; index++)
+	{
+		const HistoryFileRecord& record = records[index];
+		if (hosts[record.url] == nullptr)
+		{
+			string_view name = extractDomain(*interned[record.url]->text);
+			auto host = hostsByName.find(name);
+			if (host == hostsByName.end())
+			{
+				const InternedString* hostName = strings.intern(string(name));
+				host = hostsByName.emplace(name, make_pair(hostName, &domainIndex[reverseDomain(*hostName->text)])).first;
+			}
+			hosts[record.url] = strings.retain(host->second.first);
+			urlBuckets[record.url] = &urlIndex[interned[record.url]];
+			domainBuckets[record.url] = host->second.second;
+		}
+		if (sessionBuckets[record.sessionID] == nullptr)
+		{
+			sessionBuckets[record.sessionID] = &sessionIndex[interned[record.sessionID]];
+		}
+		Page* parent = record.parent < 0 ? nullptr : loaded[record.parent];
+		Page* page = attachPage(parent, strings.retain(interned[record.url]), strings.retain(interned[record.title]), (time_t)record.timestamp,
+			strings.retain(interned[record.sessionID]), strings.retain(hosts[record.url]), record.id,
+			PageBuckets{ urlBuckets[record.url], sessionBuckets[record.sessionID], domainBuckets[record.url] });
+		nextPageID = max(nextPageID, record.id + 1);
+		page->setExitTime((time_t)record.exitTime);
+		page->setScrollPosition(record.scrollPosition);
+		for (uint32_t field = 0; field < record.formFieldCount; field++)
+		{
+			size_t first = record.firstFormField + (size_t)field * 2;
+			page->setFormData(*interned[formFields[first]]->text, *interned[formFields[first + 1]]->text);
+		}
+		loaded[index] = page;
+	}
+	for (uint32_t index = 0; index < stringCount; index++)
+	{
+		strings.release(interned[index]);
+		if (hosts[index] != nullptr)
+		{
+			strings.release(hosts[index]);
+		}
+	}
+	for (const auto& host : hostsByName)
+	{
+		strings.release(host.second.first);
+	}
+
+	if (pageCount > 0)
+	{
+		root = loaded[0];
+		setCurrent(loaded[currentRecord]);
+	}
+	return true;
 }
 
-void BrowserHistory::clearHistory()
+
+Page* BrowserHistory::insertPage(Page* parent, const string& url, const string& title, time_t timestamp, const string& sessionID)
 {
-	if (root != nullptr)
+	if ((parent == nullptr) != (root == nullptr))
 	{
-		delete root;
-		root = nullptr;
+		return nullptr;
 	}
-	size = 0;
-	current = nullptr;
+	const InternedString* session = sessionID.empty() ? strings.retain(currentSessionID) : strings.intern(sessionID);
+	Page* page = attachPage(parent, strings.intern(url), strings.intern(title), timestamp, session, strings.intern(string(extractDomain(url))), nextPageID++);
+	if (parent == nullptr)
+	{
+		root = page;
+		setCurrent(page);
+	}
+	return page;
+}
+
+Page* BrowserHistory::replayAddPage(unsigned int id, Page* parent, const string& url, const string& title, time_t timestamp, const string& sessionID)
+{
+	if (findPageByID(id) != nullptr || (parent == nullptr) != (root == nullptr))
+	{
+		return nullptr;
+	}
+	Page* page = attachPage(parent, strings.intern(url), strings.intern(title), timestamp, strings.intern(sessionID), strings.intern(string(extractDomain(url))), id);
+	nextPageID = max(nextPageID, id + 1);
+	if (parent == nullptr)
+	{
+		root = page;
+	}
+	return page;
+}
+
+void BrowserHistory::replaySetCurrent(Page* page)
+{
+	setCurrent(page);
 }
 
+void BrowserHistory::replayRemovePage(Page* page)
+{
+	if (page == nullptr || page == root)
+	{
+		return;
+	}
+	for (Page* ancestor = current; ancestor != nullptr; ancestor = ancestor->getParent())
+	{
+		if (ancestor == page)
+		{
+			return;
+		}
+	}
+	removePage(page);
+}
+
+void BrowserHistory::replaySetMaxSize(int newMaxSize)
+{
+	if (newMaxSize >= 1)
+	{
+		maxSize = newMaxSize;
+	}
+}
@@ -2,10 +2,48 @@
 
 #include <string>
 #include "page.h"
+#include "order index.h"
+#include "page pool.h"
+#include "page columns.h"
+#include "string table.h"
+#include "trigram index.h"
+#include "history observer.h"
 #include <vector>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <atomic>
 
 using namespace std;
 
+struct PageAgeOrder
+{
+	typedef void is_transparent;
+
+	bool operator()(const Page* a, const Page* b) const;
+	bool operator()(const Page* page, time_t timestamp) const;
+	bool operator()(time_t timestamp, const Page* page) const;
+};
+
+typedef set<Page*, PageAgeOrder> PageTimeline;
+
+// A page's parent and URL, under which visit looks for an existing child to revisit.
+typedef pair<const Page*, const InternedString*> ChildKey;
+
+struct ChildKeyHash
+{
+	size_t operator()(const ChildKey& key) const;
+};
+
+// The URL, session and domain timelines a new page is filed under. Loading a file looks these up
+// once per distinct string rather than once per page.
+struct PageBuckets
+{
+	PageTimeline* sameUrl;
+	PageTimeline* sameSession;
+	PageTimeline* sameDomain;
+};
+
 class BrowserHistory
 {
 private:
@@ -13,7 +51,51 @@ private:
 	Page* current;
 	int size;
 	int maxSize;
-	string currentSessionID;
+	StringTable strings;
+	const InternedString* currentSessionID;
+	unsigned int nextPageID;
+	PageTimeline evictionIndex;
+	PageTimeline timeIndex;
+	unordered_map<const InternedString*, PageTimeline> sessionIndex;
+	map<string, PageTimeline> domainIndex;
+	unordered_map<const InternedString*, PageTimeline> urlIndex;
+	unordered_multimap<ChildKey, Page*, ChildKeyHash> childIndex;
+	OrderIndex orderIndex;
+	PagePool pagePool;
+	PageColumns columns;
+	unordered_map<unsigned int, Page*> pageDirectory;
+	bool searchIndexEnabled;
+	unsigned int scanThreads;
+	TrigramIndex titleTrigrams;
+	TrigramIndex urlTrigrams;
+	vector<HistoryObserver*> observers;
+	bool deferReclamation;
+	vector<Page*> retiredPages;
+	unordered_map<Page*, int> pinnedPages;
+	int batchDepth;
+	time_t batchTime;
+	bool prunePending;
+
+	Page* createPage(Page* parent, const string& url, const string& title, time_t timestamp);
+	Page* attachPage(Page* parent, const InternedString* url, const InternedString* title, time_t timestamp, const InternedString* sessionID, const InternedString* host, unsigned int id);
+	Page* attachPage(Page* parent, const InternedString* url, const InternedString* title, time_t timestamp, const InternedString* sessionID, const InternedString* host, unsigned int id, const PageBuckets& buckets);
+	PageBuckets bucketsFor(const InternedString* url, const InternedString* sessionID, const InternedString* host);
+	void removePage(Page* page);
+	void unindexPage(Page* page);
+	void retirePage(Page* page);
+	void reclaimPage(Page* page);
+	Page* oldestEvictablePage() const;
+	void setCurrent(Page* page);
+	void notifyPageUpdated(Page* page);
+	void notifyPageRemoving(Page* page);
+	bool deliversTo(const HistoryObserver* observer) const;
+	void evictOverflow();
+	void beginBatch();
+	void endBatch();
+	Page* findChildByURL(Page* parent, const InternedString* url) const;
+	bool leadsToPinnedPage(Page* page) const;
+	void rebuildSearchIndex();
+	bool searchIndexCandidates(const TrigramIndex& index, const string& foldedPattern, vector<Page*>& pages) const;
 
 	void updatePrevExitTime();
 	string generateSessionID() const;
@@ -22,6 +104,22 @@ private:
 	void printPage(const Page* page, int level) const;
 
 public:
+	// Groups changes: navigations inside share one clock reading, eviction runs once when the
+	// outermost batch ends, and observers that opt out of per-page events hear about it once.
+	class Batch
+	{
+	private:
+		BrowserHistory* history;
+
+	public:
+		Batch(BrowserHistory& history);
+		~Batch();
+		Batch(const Batch&) = delete;
+		Batch& operator=(const Batch&) = delete;
+
+		void commit();
+	};
+
 	BrowserHistory(int maxHistorySize = 50);
 	~BrowserHistory();
 
@@ -32,8 +130,11 @@ public:
 	bool goForward();
 	bool goBack(int steps);
 	bool goForward(int steps);
+	// Indexes count pages in the order they were added to the history, starting at the root.
 	bool goToIndex(int index);
 	bool goToURL(const string& url);
+	bool goToPage(Page* page);
+	bool goToPageID(unsigned int id);
 	bool goToHome();
 	bool goToEnd();
 	void refresh();
@@ -49,13 +150,34 @@ public:
 	void startNewSession();
 
 	void setMaxSize(int newMaxSize);
-
-
+	void setSearchIndexEnabled(bool enabled);
+	bool isSearchIndexEnabled() const;
+	// Unindexed searches over the whole history split the scan across this many threads;
+	// zero uses every core. Results come back in the same order whatever the count.
+	void setScanThreads(unsigned int threads);
+	unsigned int getScanThreads() const;
+	// While enabled, removed pages stay allocated until they are handed out by takeRetiredPages
+	// and returned through reclaimPages, so concurrent readers never see freed memory.
+	void setDeferredReclamation(bool enabled);
+	void takeRetiredPages(vector<Page*>& pages);
+	void reclaimPages(const vector<Page*>& pages);
+	// Pinned pages, and the path from the root to them, are never evicted or cut off by addPage.
+	void pinPage(Page* page);
+	void unpinPage(Page* page);
+	bool isPinned(Page* page) const;
+
+	void addObserver(HistoryObserver* observer);
+	void removeObserver(HistoryObserver* observer);
+
+	Page* getRootPage() const;
 	Page* getCurrentPage() const;
+	Page* findPageByID(unsigned int id) const;
 	int getSize() const;
 	int getMaxSize() const;
 	int getCurrentIndex() const;
-	string getCurrentSessionID() const;
+	const string& getCurrentSessionID() const;
+	// The time new pages are stamped with: the start of the open Batch, otherwise now.
+	time_t currentTime() const;
 
 	void showCurrentPage() const;
 	void showHistory() const;
@@ -65,10 +187,28 @@ public:
 	void clearHistory();
 	void clearHistory(time_t olderThan);
 
+	// Binary format: a string table followed by one record per page in creation order, each naming
+	// its parent by record index. Loading replaces the history and keeps it unchanged on failure; it
+	// does not evict, so a history saved above its cap, with forward pages past current, loads intact.
+	bool saveToFile(const string& path) const;
+	bool loadFromFile(const string& path);
+
+	// Adds a page with a caller-supplied timestamp and session (the current one when empty) without
+	// evicting; call pruneOldestPages once a batch is in. The current page only moves when the page
+	// is the root of an empty history, which becomes current.
+	Page* insertPage(Page* parent, const string& url, const string& title, time_t timestamp, const string& sessionID = "");
+
+	// Reapply recorded changes exactly as they happened: no clock reads, exit-time updates or eviction.
+	Page* replayAddPage(unsigned int id, Page* parent, const string& url, const string& title, time_t timestamp, const string& sessionID);
+	void replaySetCurrent(Page* page);
+	void replayRemovePage(Page* page);
+	void replaySetMaxSize(int newMaxSize);
+
+	// A domain of the form "*.example.com" also matches example.com and all of its subdomains.
 	vector <Page*> findPagesByDomain(const string& domain) const;
 	vector<Page*> findPagesByTitle(const string& titleSubstring) const;
 	bool goToTitle(const string& titleSubstring);
-	vector<Page*> searchPages(const string& titleSubstring = "", const string& urlSubstring = "", const string& sessionID = "", time_t startTime = 0, time_t endTime = 0) const;
+	vector<Page*> searchPages(const string& titleSubstring = "", const string& urlSubstring = "", const string& sessionID = "", time_t startTime = 0, time_t endTime = 0, const atomic<bool>* cancelled = nullptr) const;
 	bool containsSubstring(const string& str, const string& substring) const;
 	void collectAllPages(Page* page, vector<Page*>& pages) const;
 	bool findPageInTree(Page* root, const string& url, vector<Page*>& path) const;
@@ -0,0 +1,143 @@
+#include "concurrent history.h"
+
+using namespace std;
+
+ConcurrentHistory::ReadPin::ReadPin(const ConcurrentHistory* owner, size_t slot)
+	: owner(owner), slot(slot)
+{
+}
+
+ConcurrentHistory::ReadPin::ReadPin(ReadPin&& other)
+	: owner(other.owner), slot(other.slot)
+{
+	other.owner = nullptr;
+}
+
+ConcurrentHistory::ReadPin::~ReadPin()
+{
+	if (owner)
+	{
+		owner->releasePin(slot);
+	}
+}
+
+ConcurrentHistory::WriteLock::WriteLock(ConcurrentHistory& owner)
+	: owner(owner), lock(owner.engineMutex, defer_lock)
+{
+	{
+		lock_guard<mutex> gate(owner.gateMutex);
+		owner.waitingWriters++;
+	}
+	lock.lock();
+	bool lastWriter;
+	{
+		lock_guard<mutex> gate(owner.gateMutex);
+		lastWriter = --owner.waitingWriters == 0;
+	}
+	if (lastWriter)
+	{
+		owner.gateOpen.notify_all();
+	}
+}
+
+ConcurrentHistory::WriteLock::~WriteLock()
+{
+	owner.reclaim();
+}
+
+ConcurrentHistory::ConcurrentHistory(int maxHistorySize)
+	: history(maxHistorySize), waitingWriters(0), epoch(1), pinWaiters(0)
+{
+	for (atomic<unsigned long long>& pin : pins)
+	{
+		pin = 0;
+	}
+	history.setDeferredReclamation(true);
+}
+
+ConcurrentHistory::~ConcurrentHistory()
+{
+	for (auto& batch : retired)
+	{
+		history.reclaimPages(batch.second);
+	}
+}
+
+void ConcurrentHistory::waitForWriters() const
+{
+	unique_lock<mutex> gate(gateMutex);
+	gateOpen.wait(gate, [this]() { return waitingWriters == 0; });
+}
+
+bool ConcurrentHistory::tryPin(size_t& slot) const
+{
+	for (slot = 0; slot < maxPins; slot++)
+	{
+		unsigned long long idle = 0;
+		if (pins[slot].compare_exchange_strong(idle, epoch.load()))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void ConcurrentHistory::releasePin(size_t slot) const
+{
+	pins[slot] = 0;
+	// A waiter counts itself before its last look at the slots, so either that look sees this slot
+	// free or the count is seen here; the lock orders the wakeup after the waiter is asleep.
+	if (pinWaiters.load() > 0)
+	{
+		lock_guard<mutex> lock(pinMutex);
+		pinFreed.notify_one();
+	}
+}
+
+ConcurrentHistory::ReadPin ConcurrentHistory::pin() const
+{
+	size_t slot;
+	if (!tryPin(slot))
+	{
+		unique_lock<mutex> lock(pinMutex);
+		pinWaiters++;
+		pinFreed.wait(lock, [&]() { return tryPin(slot); });
+		pinWaiters--;
+	}
+	return ReadPin(this, slot);
+}
+
+ConcurrentHistory::WriteLock ConcurrentHistory::lockForWriting()
+{
+	return WriteLock(*this);
+}
+
+BrowserHistory& ConcurrentHistory::engine()
+{
+	return history;
+}
+
+void ConcurrentHistory::reclaim()
+{
+	vector<Page*> pages;
+	history.takeRetiredPages(pages);
+	if (!pages.empty())
+	{
+		retired.emplace_back(epoch.fetch_add(1), move(pages));
+	}
+
+	unsigned long long oldestPin = epoch.load();
+	for (const atomic<unsigned long long>& pin : pins)
+	{
+		unsigned long long pinned = pin.load();
+		if (pinned != 0 && pinned < oldestPin)
+		{
+			oldestPin = pinned;
+		}
+	}
+	while (!retired.empty() && retired.front().first < oldestPin)
+	{
+		history.reclaimPages(retired.front().second);
+		retired.pop_front();
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <shared_mutex>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+#include "browser history.h"
+
+using namespace std;
+
+// Shares one BrowserHistory between threads. Readers run under a shared lock and writers
+// under an exclusive one. A reader that keeps Page pointers after its read returns must
+// hold a ReadPin taken before the read; removed pages are freed once no older pin remains.
+// A pin only keeps the memory alive: outside read, a pinned page's ID, URL, title, session, host
+// and timestamp may be read, since they never change, but its scroll position, form data, exit
+// time, parent and children are written by navigation and must only be read inside read.
+// New readers wait while a writer is queued so a steady stream of searches cannot starve navigation;
+// for the same reason read must not be called from inside another read on the same thread.
+class ConcurrentHistory
+{
+public:
+	class ReadPin
+	{
+	private:
+		const ConcurrentHistory* owner;
+		size_t slot;
+
+	public:
+		ReadPin(const ConcurrentHistory* owner, size_t slot);
+		ReadPin(ReadPin&& other);
+		~ReadPin();
+		ReadPin(const ReadPin&) = delete;
+		ReadPin& operator=(const ReadPin&) = delete;
+		ReadPin& operator=(ReadPin&&) = delete;
+	};
+
+	class WriteLock
+	{
+	private:
+		ConcurrentHistory& owner;
+		unique_lock<shared_mutex> lock;
+
+	public:
+		WriteLock(ConcurrentHistory& owner);
+		~WriteLock();
+		WriteLock(const WriteLock&) = delete;
+		WriteLock& operator=(const WriteLock&) = delete;
+	};
+
+	// At most this many pins are held at once; pin blocks until another is released, so a thread
+	// must not ask for one more than that while holding them all itself.
+	static const size_t maxPins = 64;
+
+private:
+	BrowserHistory history;
+	mutable shared_mutex engineMutex;
+	mutable mutex gateMutex;
+	mutable condition_variable gateOpen;
+	int waitingWriters;
+	mutable atomic<unsigned long long> epoch;
+	mutable atomic<unsigned long long> pins[maxPins];
+	mutable mutex pinMutex;
+	mutable condition_variable pinFreed;
+	mutable atomic<int> pinWaiters;
+	deque<pair<unsigned long long, vector<Page*>>> retired;
+
+	void reclaim();
+	void waitForWriters() const;
+	bool tryPin(size_t& slot) const;
+	void releasePin(size_t slot) const;
+
+public:
+	ConcurrentHistory(int maxHistorySize = 50);
+	~ConcurrentHistory();
+	ConcurrentHistory(const ConcurrentHistory&) = delete;
+	ConcurrentHistory& operator=(const ConcurrentHistory&) = delete;
+
+	template <typename Function>
+	auto read(Function function) const -> decltype(function(declval<const BrowserHistory&>()))
+	{
+		waitForWriters();
+		shared_lock<shared_mutex> lock(engineMutex);
+		return function(static_cast<const BrowserHistory&>(history));
+	}
+
+	template <typename Function>
+	auto write(Function function) -> decltype(function(declval<BrowserHistory&>()))
+	{
+		WriteLock lock(*this);
+		return function(history);
+	}
+
+	ReadPin pin() const;
+	WriteLock lockForWriting();
+
+	// Unsynchronised access, only for the thread that performs every write.
+	BrowserHistory& engine();
+};
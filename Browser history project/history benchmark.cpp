@@ -0,0 +1,204 @@
+#include "history benchmark.h"
+#include "browser history.h"
+#include "concurrent history.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Counts the allocations made through it and hands them on to the default heap, so the copying scan
+// can be measured without replacing the program's global allocator.
+class CountingResource : public pmr::memory_resource
+{
+private:
+	unsigned long long allocations = 0;
+
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		allocations++;
+		return pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* memory, size_t bytes, size_t alignment) override
+	{
+		pmr::new_delete_resource()->deallocate(memory, bytes, alignment);
+	}
+
+	bool do_is_equal(const pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+public:
+	unsigned long long count() const
+	{
+		return allocations;
+	}
+};
+
+static double millisecondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void fillHistory(BrowserHistory& history, int pageCount)
+{
+	BrowserHistory::Batch batch(history);
+	for (int i = 0; i < pageCount; i++)
+	{
+		history.addPage("https://www.example.com/articles/" + to_string(i), "Example article number " + to_string(i));
+		if (i % 4 == 0)
+		{
+			string key = "search_query_field";
+			string value = "a form value long enough to live on the heap " + to_string(i);
+			history.addFormData(key, value);
+		}
+	}
+}
+
+void benchmarkScanAllocations(ostream& out, int pageCount)
+{
+	BrowserHistory history(pageCount);
+	fillHistory(history, pageCount);
+	vector<Page*> pages;
+	history.collectAllPages(history.getRootPage(), pages);
+
+	// The accessors return const references, so this pass makes no copies and allocates nothing.
+	size_t referenceBytes = 0;
+	auto start = chrono::steady_clock::now();
+	for (const Page* page : pages)
+	{
+		referenceBytes += page->getUrl().size() + page->getTitle().size() + page->getSessionID().size();
+		for (const auto& field : page->getFormData())
+		{
+			referenceBytes += field.first.size() + field.second.size();
+		}
+	}
+	double referenceTime = millisecondsSince(start);
+
+	// The same reads taking copies, as by-value accessors would, with every copy allocated through
+	// the counter.
+	CountingResource counter;
+	size_t copyBytes = 0;
+	start = chrono::steady_clock::now();
+	for (const Page* page : pages)
+	{
+		pmr::string url(page->getUrl(), &counter);
+		pmr::string title(page->getTitle(), &counter);
+		pmr::string sessionID(page->getSessionID(), &counter);
+		pmr::map<pmr::string, pmr::string> formData(&counter);
+		for (const auto& field : page->getFormData())
+		{
+			formData.emplace(field.first, field.second);
+		}
+		copyBytes += url.size() + title.size() + sessionID.size();
+		for (const auto& field : formData)
+		{
+			copyBytes += field.first.size() + field.second.size();
+		}
+	}
+	double copyTime = millisecondsSince(start);
+
+	out << "Full-history scan over " << pages.size() << " pages (" << referenceBytes << " bytes read)\n";
+	out << "  const references: 0 allocations, " << referenceTime << " ms\n";
+	out << "  copies:           " << counter.count() << " allocations, " << copyTime << " ms"
+		<< (copyBytes == referenceBytes ? "" : " (mismatch)") << "\n";
+}
+
+void benchmarkConcurrentHistory(ostream& out, int maxReaders, int millisecondsPerRun)
+{
+	out << "Concurrent history, one writer, " << millisecondsPerRun << " ms per run\n";
+	for (int readers = 1; readers <= maxReaders; readers++)
+	{
+		ConcurrentHistory shared(2000);
+		shared.write([](BrowserHistory& history) { fillHistory(history, 2000); });
+
+		atomic<bool> stopping(false);
+		atomic<unsigned long long> searches(0);
+		atomic<unsigned long long> navigations(0);
+		atomic<unsigned long long> resultsRead(0);
+		vector<thread> threads;
+		threads.emplace_back([&]()
+		{
+			unsigned long long count = 0;
+			while (!stopping.load())
+			{
+				shared.write([&](BrowserHistory& history)
+				{
+					if (count % 8 == 7)
+					{
+						history.goBack(3);
+					}
+					history.addPage("https://www.example.com/live/" + to_string(count), "Live page " + to_string(count));
+				});
+				count++;
+			}
+			navigations = count;
+		});
+		for (int reader = 0; reader < readers; reader++)
+		{
+			threads.emplace_back([&, reader]()
+			{
+				unsigned long long count = 0;
+				unsigned long long results = 0;
+				while (!stopping.load())
+				{
+					ConcurrentHistory::ReadPin pin = shared.pin();
+					vector<Page*> found = shared.read([&](const BrowserHistory& history)
+					{
+						return history.searchPages(to_string((count + reader) % 10));
+					});
+					for (const Page* page : found)
+					{
+						results += page->getTitle().empty() ? 0 : 1;
+					}
+					count++;
+				}
+				searches += count;
+				resultsRead += results;
+			});
+		}
+
+		this_thread::sleep_for(chrono::milliseconds(millisecondsPerRun));
+		stopping = true;
+		for (thread& worker : threads)
+		{
+			worker.join();
+		}
+		double seconds = millisecondsPerRun / 1000.0;
+		out << "  " << readers << " reader" << (readers == 1 ? ": " : "s: ") << (unsigned long long)(searches / seconds) << " searches/s, "
+			<< (unsigned long long)(resultsRead / seconds) << " results read/s, " << (unsigned long long)(navigations / seconds) << " navigations/s\n";
+	}
+}
+
+void benchmarkScanScaling(ostream& out, int pageCount, int maxThreads)
+{
+	BrowserHistory history(pageCount);
+	fillHistory(history, pageCount);
+	const int searches = 20;
+	out << "Column scan over " << history.getSize() << " pages, " << searches << " searches per thread count\n";
+	double singleThreaded = 0;
+	for (int threads = 1; threads <= maxThreads; threads++)
+	{
+		history.setScanThreads(threads);
+		size_t found = 0;
+		auto start = chrono::steady_clock::now();
+		for (int search = 0; search < searches; search++)
+		{
+			found += history.searchPages("number " + to_string(search) + "9").size();
+		}
+		double perSearch = millisecondsSince(start) / searches;
+		if (threads == 1)
+		{
+			singleThreaded = perSearch;
+		}
+		out << "  " << threads << " thread" << (threads == 1 ? ": " : "s: ") << perSearch << " ms per search, "
+			<< (perSearch > 0 ? singleThreaded / perSearch : 0) << "x, " << found << " results\n";
+	}
+	history.setScanThreads(1);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <ostream>
+
+using namespace std;
+
+// Console benchmarks for the history engine; each builds its own history and prints what it measured.
+
+// Time for one full-history scan reading every page's URL, title, session and form data through the
+// const-reference accessors, next to the same scan taking copies and the heap allocations they make.
+void benchmarkScanAllocations(ostream& out, int pageCount);
+
+// One writer navigating and pruning a shared history while 1 to maxReaders threads search it and read
+// the pages they find under a pin; reports searches and navigations per second for each reader count.
+void benchmarkConcurrentHistory(ostream& out, int maxReaders, int millisecondsPerRun);
+
+// Unindexed title searches over pageCount pages with the column scan split across 1 to maxThreads
+// threads; reports milliseconds per search and the speedup over one thread for each count.
+void benchmarkScanScaling(ostream& out, int pageCount, int maxThreads);
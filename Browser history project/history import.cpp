@@ -0,0 +1,369 @@
+#include "history import.h"
+#include "mapped file.h"
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+struct ImportRecord
+{
+	string_view id;
+	string_view parent;
+	string_view timestamp;
+	string_view sessionID;
+	string_view url;
+	string_view title;
+};
+
+static bool parseInteger(string_view text, int64_t& value)
+{
+	bool negative = !text.empty() && text[0] == '-';
+	if (negative)
+	{
+		text.remove_prefix(1);
+	}
+	if (text.empty() || text.size() > 18)
+	{
+		return false;
+	}
+	value = 0;
+	for (char c : text)
+	{
+		if (c < '0' || c > '9')
+		{
+			return false;
+		}
+		value = value * 10 + (c - '0');
+	}
+	if (negative)
+	{
+		value = -value;
+	}
+	return true;
+}
+
+static bool parseTsvLine(string_view line, ImportRecord& record)
+{
+	string_view* fields[] = { &record.id, &record.parent, &record.timestamp, &record.sessionID, &record.url, &record.title };
+	for (size_t field = 0; field < 6; field++)
+	{
+		size_t tab = field < 5 ? line.find('\t') : string_view::npos;
+		if (field < 5 && tab == string_view::npos)
+		{
+			return false;
+		}
+		*fields[field] = line.substr(0, tab);
+		line.remove_prefix(tab == string_view::npos ? line.size() : tab + 1);
+	}
+	return true;
+}
+
+static void appendUtf8(string& out, uint32_t code)
+{
+	if (code < 0x80)
+	{
+		out += (char)code;
+	}
+	else if (code < 0x800)
+	{
+		out += (char)(0xC0 | (code >> 6));
+		out += (char)(0x80 | (code & 0x3F));
+	}
+	else if (code < 0x10000)
+	{
+		out += (char)(0xE0 | (code >> 12));
+		out += (char)(0x80 | ((code >> 6) & 0x3F));
+		out += (char)(0x80 | (code & 0x3F));
+	}
+	else
+	{
+		out += (char)(0xF0 | (code >> 18));
+		out += (char)(0x80 | ((code >> 12) & 0x3F));
+		out += (char)(0x80 | ((code >> 6) & 0x3F));
+		out += (char)(0x80 | (code & 0x3F));
+	}
+}
+
+static bool parseHex4(string_view text, size_t at, uint32_t& code)
+{
+	if (at + 4 > text.size())
+	{
+		return false;
+	}
+	code = 0;
+	for (size_t i = at; i < at + 4; i++)
+	{
+		char c = text[i];
+		code <<= 4;
+		if (c >= '0' && c <= '9')
+		{
+			code |= c - '0';
+		}
+		else if (c >= 'a' && c <= 'f')
+		{
+			code |= c - 'a' + 10;
+		}
+		else if (c >= 'A' && c <= 'F')
+		{
+			code |= c - 'A' + 10;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// JSON strings without escapes are returned as views into the line. Escaped ones are decoded into
+// one of the scratch buffers, which are reused from line to line.
+class JsonLineParser
+{
+private:
+	string_view line;
+	size_t position;
+	string scratch[6];
+	size_t scratchUsed;
+
+	void skipSpace()
+	{
+		while (position < line.size() && (line[position] == ' ' || line[position] == '\t'))
+		{
+			position++;
+		}
+	}
+
+	bool expect(char c)
+	{
+		skipSpace();
+		if (position < line.size() && line[position] == c)
+		{
+			position++;
+			return true;
+		}
+		return false;
+	}
+
+	bool parseString(string_view& value)
+	{
+		if (!expect('"'))
+		{
+			return false;
+		}
+		size_t start = position;
+		while (position < line.size() && line[position] != '"' && line[position] != '\\')
+		{
+			position++;
+		}
+		if (position < line.size() && line[position] == '"')
+		{
+			value = line.substr(start, position - start);
+			position++;
+			return true;
+		}
+		if (scratchUsed == 6)
+		{
+			return false;
+		}
+		string& decoded = scratch[scratchUsed++];
+		decoded.assign(line.data() + start, position - start);
+		while (position < line.size() && line[position] != '"')
+		{
+			char c = line[position++];
+			if (c != '\\')
+			{
+				decoded += c;
+				continue;
+			}
+			if (position >= line.size())
+			{
+				return false;
+			}
+			char escape = line[position++];
+			uint32_t code;
+			switch (escape)
+			{
+			case '"': decoded += '"'; break;
+			case '\\': decoded += '\\'; break;
+			case '/': decoded += '/'; break;
+			case 'b': decoded += '\b'; break;
+			case 'f': decoded += '\f'; break;
+			case 'n': decoded += '\n'; break;
+			case 'r': decoded += '\r'; break;
+			case 't': decoded += '\t'; break;
+			case 'u':
+				if (!parseHex4(line, position, code))
+				{
+					return false;
+				}
+				position += 4;
+				if (code >= 0xD800 && code < 0xDC00 && position + 6 <= line.size() && line[position] == '\\' && line[position + 1] == 'u')
+				{
+					uint32_t low;
+					if (parseHex4(line, position + 2, low) && low >= 0xDC00 && low < 0xE000)
+					{
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+						position += 6;
+					}
+				}
+				appendUtf8(decoded, code);
+				break;
+			default:
+				return false;
+			}
+		}
+		if (position >= line.size())
+		{
+			return false;
+		}
+		position++;
+		value = decoded;
+		return true;
+	}
+
+	bool parseScalar(string_view& value)
+	{
+		skipSpace();
+		if (position < line.size() && line[position] == '"')
+		{
+			return parseString(value);
+		}
+		size_t start = position;
+		while (position < line.size() && line[position] != ',' && line[position] != '}' && line[position] != ' ' && line[position] != '\t')
+		{
+			position++;
+		}
+		value = line.substr(start, position - start);
+		if (value == "null")
+		{
+			value = string_view();
+		}
+		return !value.empty() || position > start;
+	}
+
+public:
+	bool parse(string_view text, ImportRecord& record)
+	{
+		line = text;
+		position = 0;
+		scratchUsed = 0;
+		record = ImportRecord();
+		if (!expect('{'))
+		{
+			return false;
+		}
+		if (expect('}'))
+		{
+			return false;
+		}
+		do
+		{
+			string_view key, value;
+			if (!parseString(key) || !expect(':') || !parseScalar(value))
+			{
+				return false;
+			}
+			string_view* field = key == "id" ? &record.id
+				: key == "parent" ? &record.parent
+				: key == "timestamp" ? &record.timestamp
+				: key == "session" ? &record.sessionID
+				: key == "url" ? &record.url
+				: key == "title" ? &record.title
+				: nullptr;
+			if (field != nullptr)
+			{
+				*field = value;
+			}
+		} while (expect(','));
+		return expect('}');
+	}
+};
+
+bool importHistory(BrowserHistory& history, const string& path, ImportFormat format, ImportStats* stats)
+{
+	ImportStats counts = { 0, 0 };
+	MappedFile file;
+	if (!file.open(path))
+	{
+		if (stats != nullptr)
+		{
+			*stats = counts;
+		}
+		return false;
+	}
+
+	unordered_map<int64_t, Page*> pagesByID;
+	JsonLineParser jsonParser;
+	ImportRecord record;
+	string url, title, sessionID;
+	Page* newest = nullptr;
+	bool startedEmpty = history.getRootPage() == nullptr;
+	BrowserHistory::Batch batch(history);
+
+	string_view remaining(file.getData(), file.getSize());
+	while (!remaining.empty())
+	{
+		size_t end = remaining.find('\n');
+		string_view line = remaining.substr(0, end);
+		remaining.remove_prefix(end == string_view::npos ? remaining.size() : end + 1);
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.remove_suffix(1);
+		}
+		if (line.empty())
+		{
+			continue;
+		}
+
+		bool parsed = format == ImportFormat::TSV ? parseTsvLine(line, record) : jsonParser.parse(line, record);
+		int64_t id, parentID = 0, timestamp;
+		bool hasParent = !record.parent.empty() && record.parent != "-";
+		if (!parsed || record.url.empty() || !parseInteger(record.id, id) || !parseInteger(record.timestamp, timestamp)
+			|| (hasParent && !parseInteger(record.parent, parentID)))
+		{
+			counts.skipped++;
+			continue;
+		}
+
+		Page* parent = history.getRootPage();
+		if (hasParent)
+		{
+			auto found = pagesByID.find(parentID);
+			parent = found != pagesByID.end() ? found->second : nullptr;
+			if (parent == nullptr)
+			{
+				counts.skipped++;
+				continue;
+			}
+		}
+
+		url.assign(record.url.data(), record.url.size());
+		title.assign(record.title.data(), record.title.size());
+		sessionID.assign(record.sessionID.data(), record.sessionID.size());
+		Page* page = history.insertPage(parent, url, title, (time_t)timestamp, sessionID);
+		if (page == nullptr)
+		{
+			counts.skipped++;
+			continue;
+		}
+		pagesByID[id] = page;
+		if (newest == nullptr || timestamp >= (int64_t)newest->getTimestamp())
+		{
+			newest = page;
+		}
+		counts.imported++;
+	}
+
+	if (startedEmpty && newest != nullptr)
+	{
+		history.goToPage(newest);
+	}
+	history.pruneOldestPages();
+	batch.commit();
+	if (stats != nullptr)
+	{
+		*stats = counts;
+	}
+	return true;
+}
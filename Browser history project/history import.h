@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include "browser history.h"
+
+using namespace std;
+
+enum class ImportFormat
+{
+	TSV,
+	JSONL
+};
+
+struct ImportStats
+{
+	size_t imported;
+	size_t skipped;
+};
+
+// Streams a line-delimited history dump into the history in a single pass. Each record carries an
+// id, the id of its parent (empty, "-" or null for none), a timestamp in seconds, a session, a url
+// and a title; a TSV line lists them in that order. Parents must appear before their children;
+// records without a parent hang off the root. Pages keep the timestamps from the dump, eviction
+// runs once at the end, and lines that cannot be parsed or whose parent is unknown are skipped.
+bool importHistory(BrowserHistory& history, const string& path, ImportFormat format, ImportStats* stats = nullptr);
@@ -0,0 +1,292 @@
+#include "history journal.h"
+#include "binary stream.h"
+#include <filesystem>
+
+using namespace std;
+
+enum JournalRecordKind : uint32_t
+{
+	JOURNAL_PAGE_ADDED = 1,
+	JOURNAL_PAGE_REMOVED,
+	JOURNAL_CURRENT_CHANGED,
+	JOURNAL_HISTORY_CLEARED,
+	JOURNAL_PAGE_UPDATED,
+	JOURNAL_MAX_SIZE_CHANGED
+};
+
+static const size_t journalBufferLimit = 64 * 1024;
+
+static uint32_t checksum(const char* data, size_t length)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+HistoryJournal::HistoryJournal(BrowserHistory& history, const string& path, int syncIntervalMilliseconds, size_t compactAfter)
+	: history(history), snapshotPath(path), journalPath(path + ".journal"), journal(nullptr),
+	syncInterval(chrono::milliseconds(syncIntervalMilliseconds)), lastSync(chrono::steady_clock::now()), compactAfter(compactAfter), journalRecords(0), snapshotLoaded(false)
+{
+}
+
+HistoryJournal::~HistoryJournal()
+{
+	history.removeObserver(this);
+	flush();
+	if (journal != nullptr)
+	{
+		fclose(journal);
+	}
+}
+
+bool HistoryJournal::openJournal(bool truncate)
+{
+	if (journal != nullptr)
+	{
+		fclose(journal);
+	}
+	journal = openFile(journalPath, truncate ? "wb" : "ab");
+	return journal != nullptr;
+}
+
+bool HistoryJournal::open()
+{
+	history.removeObserver(this);
+	// A snapshot that is there but will not load is left alone rather than read as an empty history.
+	error_code error;
+	bool snapshotExists = filesystem::exists(snapshotPath, error);
+	snapshotLoaded = !error && (!snapshotExists || history.loadFromFile(snapshotPath));
+	if (!snapshotLoaded || !replay() || !openJournal(false))
+	{
+		return false;
+	}
+	history.addObserver(this);
+	return true;
+}
+
+bool HistoryJournal::replay()
+{
+	vector<char> contents;
+	journalRecords = 0;
+	if (!readWholeFile(journalPath, contents))
+	{
+		return true;
+	}
+
+	size_t validLength = 0;
+	while (contents.size() - validLength >= 4)
+	{
+		uint32_t length, storedChecksum;
+		BinaryReader(contents.data() + validLength, 4).readU32(length);
+		if (length < 4 || contents.size() - validLength - 4 < (size_t)length + 4)
+		{
+			break;
+		}
+		const char* body = contents.data() + validLength + 4;
+		BinaryReader(body + length, 4).readU32(storedChecksum);
+		if (storedChecksum != checksum(body, length))
+		{
+			break;
+		}
+		validLength += (size_t)length + 8;
+		journalRecords++;
+
+		BinaryReader payload(body, length);
+
+		uint32_t kind, id;
+		payload.readU32(kind);
+		if (kind == JOURNAL_PAGE_ADDED)
+		{
+			int64_t parentID, timestamp;
+			string url, title, sessionID;
+			if (payload.readU32(id) && payload.readI64(parentID) && payload.readI64(timestamp)
+				&& payload.readString(url) && payload.readString(title) && payload.readString(sessionID))
+			{
+				Page* parent = parentID < 0 ? nullptr : history.findPageByID((unsigned int)parentID);
+				if (parentID < 0 || parent != nullptr)
+				{
+					history.replayAddPage(id, parent, url, title, (time_t)timestamp, sessionID);
+				}
+			}
+		}
+		else if (kind == JOURNAL_PAGE_REMOVED)
+		{
+			if (payload.readU32(id))
+			{
+				history.replayRemovePage(history.findPageByID(id));
+			}
+		}
+		else if (kind == JOURNAL_CURRENT_CHANGED)
+		{
+			Page* page = payload.readU32(id) ? history.findPageByID(id) : nullptr;
+			if (page != nullptr)
+			{
+				history.replaySetCurrent(page);
+			}
+		}
+		else if (kind == JOURNAL_HISTORY_CLEARED)
+		{
+			history.clearHistory();
+		}
+		else if (kind == JOURNAL_MAX_SIZE_CHANGED)
+		{
+			int32_t maxSize;
+			if (payload.readI32(maxSize))
+			{
+				history.replaySetMaxSize(maxSize);
+			}
+		}
+		else if (kind == JOURNAL_PAGE_UPDATED)
+		{
+			int64_t exitTime;
+			int32_t scrollPosition;
+			uint32_t fieldCount;
+			if (payload.readU32(id) && payload.readI64(exitTime) && payload.readI32(scrollPosition) && payload.readU32(fieldCount))
+			{
+				Page* page = history.findPageByID(id);
+				if (page != nullptr)
+				{
+					page->setExitTime((time_t)exitTime);
+					page->setScrollPosition(scrollPosition);
+				}
+				string key, value;
+				for (uint32_t field = 0; field < fieldCount && payload.readString(key) && payload.readString(value); field++)
+				{
+					if (page != nullptr)
+					{
+						page->setFormData(key, value);
+					}
+				}
+			}
+		}
+	}
+
+	if (validLength < contents.size())
+	{
+		error_code error;
+		filesystem::resize_file(journalPath, validLength, error);
+		return !error;
+	}
+	return true;
+}
+
+void HistoryJournal::append(uint32_t kind, const vector<char>& payload)
+{
+	size_t start = pending.size();
+	BinaryWriter writer(pending);
+	writer.writeU32((uint32_t)payload.size() + 4);
+	writer.writeU32(kind);
+	pending.insert(pending.end(), payload.begin(), payload.end());
+	writer.writeU32(checksum(pending.data() + start + 4, payload.size() + 4));
+	journalRecords++;
+
+	if (pending.size() >= journalBufferLimit || chrono::steady_clock::now() - lastSync >= syncInterval)
+	{
+		flush();
+	}
+}
+
+bool HistoryJournal::flush()
+{
+	lastSync = chrono::steady_clock::now();
+	if (journal == nullptr)
+	{
+		return pending.empty();
+	}
+	if (!pending.empty() && fwrite(pending.data(), 1, pending.size(), journal) != pending.size())
+	{
+		return false;
+	}
+	pending.clear();
+	return syncToDisk(journal);
+}
+
+bool HistoryJournal::flushIfDue()
+{
+	if (journalRecords >= compactAfter)
+	{
+		return compact();
+	}
+	if (pending.empty() || chrono::steady_clock::now() - lastSync < syncInterval)
+	{
+		return true;
+	}
+	return flush();
+}
+
+bool HistoryJournal::compact()
+{
+	// The snapshot is on disk before the log is cut; a crash in between replays changes the snapshot
+	// already holds, which leaves the same history.
+	if (!snapshotLoaded || !flush() || !history.saveToFile(snapshotPath) || !openJournal(true))
+	{
+		return false;
+	}
+	journalRecords = 0;
+	return true;
+}
+
+void HistoryJournal::onPageAdded(Page* page)
+{
+	vector<char> payload;
+	BinaryWriter writer(payload);
+	writer.writeU32(page->getID());
+	writer.writeI64(page->getParent() ? (int64_t)page->getParent()->getID() : -1);
+	writer.writeI64((int64_t)page->getTimestamp());
+	writer.writeString(page->getUrl());
+	writer.writeString(page->getTitle());
+	writer.writeString(page->getSessionID());
+	append(JOURNAL_PAGE_ADDED, payload);
+}
+
+void HistoryJournal::onPageRemoving(Page* page)
+{
+	vector<char> payload;
+	BinaryWriter writer(payload);
+	writer.writeU32(page->getID());
+	append(JOURNAL_PAGE_REMOVED, payload);
+}
+
+void HistoryJournal::onCurrentPageChanged(Page*, Page* current)
+{
+	if (current == nullptr)
+	{
+		return;
+	}
+	vector<char> payload;
+	BinaryWriter writer(payload);
+	writer.writeU32(current->getID());
+	append(JOURNAL_CURRENT_CHANGED, payload);
+}
+
+void HistoryJournal::onHistoryCleared()
+{
+	append(JOURNAL_HISTORY_CLEARED, vector<char>());
+}
+
+void HistoryJournal::onPageUpdated(Page* page)
+{
+	vector<char> payload;
+	BinaryWriter writer(payload);
+	writer.writeU32(page->getID());
+	writer.writeI64((int64_t)page->getExitTime());
+	writer.writeI32(page->getScrollPosition());
+	writer.writeU32((uint32_t)page->getFormData().size());
+	for (const auto& field : page->getFormData())
+	{
+		writer.writeString(field.first);
+		writer.writeString(field.second);
+	}
+	append(JOURNAL_PAGE_UPDATED, payload);
+}
+
+void HistoryJournal::onMaxSizeChanged(int maxSize)
+{
+	vector<char> payload;
+	BinaryWriter writer(payload);
+	writer.writeI32(maxSize);
+	append(JOURNAL_MAX_SIZE_CHANGED, payload);
+}
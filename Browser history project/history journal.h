@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include "browser history.h"
+#include "history observer.h"
+
+using namespace std;
+
+// Keeps a history on disk as a snapshot written by saveToFile plus an append-only log of every
+// change since. Changes are buffered and written with an fsync once the sync interval has passed
+// or flush is called; the log is folded into a new snapshot once it holds compactAfter records.
+class HistoryJournal : public HistoryObserver
+{
+private:
+	BrowserHistory& history;
+	string snapshotPath;
+	string journalPath;
+	FILE* journal;
+	vector<char> pending;
+	chrono::steady_clock::duration syncInterval;
+	chrono::steady_clock::time_point lastSync;
+	size_t compactAfter;
+	size_t journalRecords;
+	bool snapshotLoaded;
+
+	void append(uint32_t kind, const vector<char>& payload);
+	bool replay();
+	bool openJournal(bool truncate);
+
+public:
+	HistoryJournal(BrowserHistory& history, const string& path, int syncIntervalMilliseconds = 1000, size_t compactAfter = 10000);
+	~HistoryJournal();
+	HistoryJournal(const HistoryJournal&) = delete;
+	HistoryJournal& operator=(const HistoryJournal&) = delete;
+
+	// Loads the snapshot, replays the log on top of it and starts recording. A torn record at the
+	// end of the log, left by a crash, is dropped. Fails without recording if the snapshot exists but
+	// cannot be read; compact then refuses to write over it.
+	bool open();
+	bool flush();
+	bool flushIfDue();
+	bool compact();
+
+	void onPageAdded(Page* page) override;
+	void onPageRemoving(Page* page) override;
+	void onCurrentPageChanged(Page* previous, Page* current) override;
+	void onHistoryCleared() override;
+	void onPageUpdated(Page* page) override;
+	void onMaxSizeChanged(int maxSize) override;
+};
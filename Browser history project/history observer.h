@@ -0,0 +1,22 @@
+#pragma once
+
+#include "page.h"
+
+class HistoryObserver
+{
+public:
+	virtual ~HistoryObserver() {}
+
+	virtual void onPageAdded(Page*) {}
+	// Sent once for the root of each removed subtree, before any of it is freed.
+	virtual void onPageRemoving(Page* page) = 0;
+	virtual void onCurrentPageChanged(Page*, Page*) {}
+	virtual void onHistoryCleared() = 0;
+	virtual void onPageUpdated(Page*) {}
+	virtual void onMaxSizeChanged(int) {}
+
+	// Observers that return false get no per-page callbacks inside a BrowserHistory::Batch,
+	// only onBatchCommitted once it ends.
+	virtual bool wantsBatchedEvents() const { return true; }
+	virtual void onBatchCommitted() {}
+};
@@ -0,0 +1,279 @@
+#include "history snapshot.h"
+#include "binary stream.h"
+#include "text search.h"
+#include <unordered_map>
+#include <cstring>
+
+using namespace std;
+
+static_assert(sizeof(SnapshotString) == 16, "snapshot strings must be 16 bytes");
+static_assert(sizeof(SnapshotRecord) == 128, "snapshot records must be 128 bytes");
+static_assert(sizeof(SnapshotHeader) == 48, "snapshot header must be 48 bytes");
+
+static const uint32_t snapshotMagic = 0x53534842;
+static const uint32_t snapshotVersion = 1;
+
+HistorySnapshot::HistorySnapshot()
+	: records(nullptr), pageCount(0), pool(nullptr), poolSize(0), currentRecord(-1)
+{
+}
+
+bool HistorySnapshot::write(const BrowserHistory& history, const string& path)
+{
+	vector<Page*> pages = history.searchPages();
+
+	unordered_map<const Page*, int64_t> recordIndex;
+	recordIndex.reserve(pages.size());
+	for (Page* page : pages)
+	{
+		recordIndex[page] = (int64_t)recordIndex.size();
+	}
+
+	vector<char> stringPool;
+	unordered_map<string, SnapshotString> pooled;
+	auto addString = [&](const string& text)
+	{
+		auto entry = pooled.emplace(text, SnapshotString());
+		if (entry.second)
+		{
+			entry.first->second = SnapshotString{ stringPool.size(), (uint32_t)text.size(), 0 };
+			stringPool.insert(stringPool.end(), text.begin(), text.end());
+		}
+		return entry.first->second;
+	};
+
+	vector<SnapshotRecord> snapshotRecords(pages.size());
+	for (size_t index = 0; index < pages.size(); index++)
+	{
+		const Page* page = pages[index];
+		SnapshotRecord& record = snapshotRecords[index];
+		record.timestamp = (int64_t)page->getTimestamp();
+		record.exitTime = (int64_t)page->getExitTime();
+		record.parent = page->getParent() ? recordIndex.at(page->getParent()) : -1;
+		record.scrollPosition = page->getScrollPosition();
+		record.reserved = 0;
+		record.url = addString(page->getUrl());
+		record.title = addString(page->getTitle());
+		record.sessionID = addString(page->getSessionID());
+		record.host = addString(page->getHost());
+		record.foldedUrl = addString(page->getInternedUrl()->lower());
+		record.foldedTitle = addString(page->getInternedTitle()->lower());
+	}
+
+	SnapshotHeader header;
+	header.magic = snapshotMagic;
+	header.version = snapshotVersion;
+	header.pageCount = pages.size();
+	header.recordsOffset = sizeof(SnapshotHeader);
+	header.poolOffset = header.recordsOffset + pages.size() * sizeof(SnapshotRecord);
+	header.poolSize = stringPool.size();
+	Page* current = history.getCurrentPage();
+	header.currentRecord = current ? recordIndex.at(current) : -1;
+
+	vector<char> contents(header.poolOffset + stringPool.size());
+	memcpy(contents.data(), &header, sizeof(header));
+	if (!snapshotRecords.empty())
+	{
+		memcpy(contents.data() + header.recordsOffset, snapshotRecords.data(), snapshotRecords.size() * sizeof(SnapshotRecord));
+	}
+	if (!stringPool.empty())
+	{
+		memcpy(contents.data() + header.poolOffset, stringPool.data(), stringPool.size());
+	}
+	return writeWholeFile(path, contents);
+}
+
+bool HistorySnapshot::open(const string& path)
+{
+	close();
+	if (!file.open(path) || file.getSize() < sizeof(SnapshotHeader))
+	{
+		close();
+		return false;
+	}
+
+	SnapshotHeader header;
+	memcpy(&header, file.getData(), sizeof(header));
+	uint64_t fileSize = file.getSize();
+	if (header.magic != snapshotMagic || header.version != snapshotVersion
+		|| header.recordsOffset != sizeof(SnapshotHeader)
+		|| header.pageCount > (fileSize - header.recordsOffset) / sizeof(SnapshotRecord)
+		|| header.poolOffset != header.recordsOffset + header.pageCount * sizeof(SnapshotRecord)
+		|| header.poolSize > fileSize - header.poolOffset
+		|| header.currentRecord >= (int64_t)header.pageCount)
+	{
+		close();
+		return false;
+	}
+
+	records = reinterpret_cast<const SnapshotRecord*>(file.getData() + header.recordsOffset);
+	pageCount = (size_t)header.pageCount;
+	pool = file.getData() + header.poolOffset;
+	poolSize = header.poolSize;
+	currentRecord = header.currentRecord;
+	return true;
+}
+
+void HistorySnapshot::close()
+{
+	file.close();
+	records = nullptr;
+	pageCount = 0;
+	pool = nullptr;
+	poolSize = 0;
+	currentRecord = -1;
+}
+
+bool HistorySnapshot::isOpen() const
+{
+	return file.isOpen();
+}
+
+string_view HistorySnapshot::text(const SnapshotString& str) const
+{
+	if (str.offset > poolSize || str.length > poolSize - str.offset)
+	{
+		return string_view();
+	}
+	return string_view(pool + str.offset, str.length);
+}
+
+size_t HistorySnapshot::firstAtOrAfter(time_t timestamp) const
+{
+	size_t low = 0, high = pageCount;
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (records[middle].timestamp < (int64_t)timestamp)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+size_t HistorySnapshot::getPageCount() const
+{
+	return pageCount;
+}
+
+int64_t HistorySnapshot::getCurrentIndex() const
+{
+	return currentRecord;
+}
+
+int64_t HistorySnapshot::getParent(size_t index) const
+{
+	int64_t parent = records[index].parent;
+	return parent < (int64_t)pageCount ? parent : -1;
+}
+
+string_view HistorySnapshot::getUrl(size_t index) const
+{
+	return text(records[index].url);
+}
+
+string_view HistorySnapshot::getTitle(size_t index) const
+{
+	return text(records[index].title);
+}
+
+string_view HistorySnapshot::getSessionID(size_t index) const
+{
+	return text(records[index].sessionID);
+}
+
+string_view HistorySnapshot::getHost(size_t index) const
+{
+	return text(records[index].host);
+}
+
+time_t HistorySnapshot::getTimestamp(size_t index) const
+{
+	return (time_t)records[index].timestamp;
+}
+
+time_t HistorySnapshot::getExitTime(size_t index) const
+{
+	return (time_t)records[index].exitTime;
+}
+
+int HistorySnapshot::getScrollPosition(size_t index) const
+{
+	return records[index].scrollPosition;
+}
+
+vector<size_t> HistorySnapshot::findPagesByDomain(const string& domain) const
+{
+	vector<size_t> results;
+	bool withSubdomains = domain.compare(0, 2, "*.") == 0;
+	string_view name = withSubdomains ? string_view(domain).substr(2) : string_view(domain);
+	for (size_t index = 0; index < pageCount; index++)
+	{
+		string_view host = text(records[index].host);
+		bool match = host == name;
+		if (!match && withSubdomains && host.size() > name.size())
+		{
+			size_t dot = host.size() - name.size() - 1;
+			match = host[dot] == '.' && host.compare(dot + 1, name.size(), name) == 0;
+		}
+		if (match)
+		{
+			results.push_back(index);
+		}
+	}
+	return results;
+}
+
+vector<size_t> HistorySnapshot::findPagesByTitle(const string& titleSubstring) const
+{
+	if (titleSubstring.empty())
+	{
+		return vector<size_t>();
+	}
+	return searchPages(titleSubstring);
+}
+
+vector<size_t> HistorySnapshot::searchPages(const string& titleSubstring, const string& urlSubstring, const string& sessionID, time_t startTime, time_t endTime) const
+{
+	vector<size_t> results;
+	if (startTime > 0 && endTime > 0 && startTime > endTime)
+	{
+		return results;
+	}
+	const string titleNeedle = foldCase(titleSubstring);
+	const string urlNeedle = foldCase(urlSubstring);
+
+	size_t first = startTime > 0 ? firstAtOrAfter(startTime) : 0;
+	size_t last = endTime > 0 ? firstAtOrAfter(endTime + 1) : pageCount;
+	for (size_t index = first; index < last; index++)
+	{
+		const SnapshotRecord& record = records[index];
+		if (!sessionID.empty() && text(record.sessionID) != sessionID)
+		{
+			continue;
+		}
+		if (!titleNeedle.empty())
+		{
+			string_view title = text(record.foldedTitle);
+			if (!containsFolded(title.data(), title.size(), titleNeedle))
+			{
+				continue;
+			}
+		}
+		if (!urlNeedle.empty())
+		{
+			string_view url = text(record.foldedUrl);
+			if (!containsFolded(url.data(), url.size(), urlNeedle))
+			{
+				continue;
+			}
+		}
+		results.push_back(index);
+	}
+	return results;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <ctime>
+#include "browser history.h"
+#include "mapped file.h"
+
+using namespace std;
+
+struct SnapshotString
+{
+	uint64_t offset;
+	uint32_t length;
+	uint32_t reserved;
+};
+
+struct SnapshotRecord
+{
+	int64_t timestamp;
+	int64_t exitTime;
+	int64_t parent;
+	int32_t scrollPosition;
+	uint32_t reserved;
+	SnapshotString url;
+	SnapshotString title;
+	SnapshotString sessionID;
+	SnapshotString host;
+	SnapshotString foldedUrl;
+	SnapshotString foldedTitle;
+};
+
+struct SnapshotHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t pageCount;
+	uint64_t recordsOffset;
+	uint64_t poolOffset;
+	uint64_t poolSize;
+	int64_t currentRecord;
+};
+
+// A read-only history that is queried straight from a memory-mapped file. Records are fixed-size,
+// sorted oldest first, and point into a string pool that also holds case-folded urls and titles,
+// so opening is constant time and queries only touch the records they scan. Pages are identified
+// by record index. The layout is the native little-endian one and form data is not kept.
+class HistorySnapshot
+{
+private:
+	MappedFile file;
+	const SnapshotRecord* records;
+	size_t pageCount;
+	const char* pool;
+	uint64_t poolSize;
+	int64_t currentRecord;
+
+	string_view text(const SnapshotString& str) const;
+	size_t firstAtOrAfter(time_t timestamp) const;
+
+public:
+	HistorySnapshot();
+
+	static bool write(const BrowserHistory& history, const string& path);
+
+	bool open(const string& path);
+	void close();
+	bool isOpen() const;
+
+	size_t getPageCount() const;
+	int64_t getCurrentIndex() const;
+	int64_t getParent(size_t index) const;
+	string_view getUrl(size_t index) const;
+	string_view getTitle(size_t index) const;
+	string_view getSessionID(size_t index) const;
+	string_view getHost(size_t index) const;
+	time_t getTimestamp(size_t index) const;
+	time_t getExitTime(size_t index) const;
+	int getScrollPosition(size_t index) const;
+
+	vector<size_t> findPagesByDomain(const string& domain) const;
+	vector<size_t> findPagesByTitle(const string& titleSubstring) const;
+	vector<size_t> searchPages(const string& titleSubstring = "", const string& urlSubstring = "", const string& sessionID = "", time_t startTime = 0, time_t endTime = 0) const;
+};
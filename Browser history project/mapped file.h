@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+// A read-only view of a whole file. The operating system pages the contents in on first access.
+class MappedFile
+{
+private:
+	const char* data;
+	size_t size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int descriptor;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const string& path);
+	void close();
+	bool isOpen() const;
+	const char* getData() const;
+	size_t getSize() const;
+};
@@ -0,0 +1,128 @@
+#include "order index.h"
+
+using namespace std;
+
+OrderIndex::OrderIndex()
+	: liveCount(0) {}
+
+int OrderIndex::prefixCount(int slotCount) const
+{
+	int total = 0;
+	for (int i = slotCount; i > 0; i -= i & -i)
+	{
+		total += tree[i - 1];
+	}
+	return total;
+}
+
+void OrderIndex::append(Page* page)
+{
+	if (slots.size() >= 64 && slots.size() >= 2 * (size_t)liveCount)
+	{
+		compact();
+	}
+	int position = slots.size() + 1;
+	page->setOrderSlot(position - 1);
+	slots.push_back(page);
+	tree.push_back(1 + prefixCount(position - 1) - prefixCount(position - (position & -position)));
+	liveCount++;
+}
+
+void OrderIndex::remove(Page* page)
+{
+	int slot = page->getOrderSlot();
+	if (slot < 0 || slot >= (int)slots.size() || slots[slot] != page)
+	{
+		return;
+	}
+	slots[slot] = nullptr;
+	for (int i = slot + 1; i <= (int)tree.size(); i += i & -i)
+	{
+		tree[i - 1]--;
+	}
+	page->setOrderSlot(-1);
+	liveCount--;
+}
+
+void OrderIndex::compact()
+{
+	vector<Page*> live;
+	live.reserve(liveCount);
+	for (Page* page : slots)
+	{
+		if (page != nullptr)
+		{
+			page->setOrderSlot(live.size());
+			live.push_back(page);
+		}
+	}
+	slots.swap(live);
+
+	tree.assign(slots.size(), 1);
+	for (int i = 1; i <= (int)tree.size(); i++)
+	{
+		int parent = i + (i & -i);
+		if (parent <= (int)tree.size())
+		{
+			tree[parent - 1] += tree[i - 1];
+		}
+	}
+}
+
+void OrderIndex::clear()
+{
+	slots.clear();
+	tree.clear();
+	liveCount = 0;
+}
+
+Page* OrderIndex::pageAt(int index) const
+{
+	if (index < 0 || index >= liveCount)
+	{
+		return nullptr;
+	}
+	int position = 0;
+	int remaining = index + 1;
+	int step = 1;
+	while (step * 2 <= (int)tree.size())
+	{
+		step *= 2;
+	}
+	for (; step > 0; step /= 2)
+	{
+		if (position + step <= (int)tree.size() && tree[position + step - 1] < remaining)
+		{
+			position += step;
+			remaining -= tree[position - 1];
+		}
+	}
+	return slots[position];
+}
+
+int OrderIndex::indexOf(const Page* page) const
+{
+	int slot = page->getOrderSlot();
+	if (slot < 0 || slot >= (int)slots.size() || slots[slot] != page)
+	{
+		return -1;
+	}
+	return prefixCount(slot + 1) - 1;
+}
+
+int OrderIndex::count() const
+{
+	return liveCount;
+}
+
+void OrderIndex::collect(vector<Page*>& pages) const
+{
+	pages.reserve(pages.size() + liveCount);
+	for (Page* page : slots)
+	{
+		if (page != nullptr)
+		{
+			pages.push_back(page);
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include "page.h"
+
+using namespace std;
+
+class OrderIndex
+{
+private:
+	vector<Page*> slots;
+	vector<int> tree;
+	int liveCount;
+
+	int prefixCount(int slotCount) const;
+	void compact();
+
+public:
+	OrderIndex();
+
+	void append(Page* page);
+	void remove(Page* page);
+	void clear();
+
+	Page* pageAt(int index) const;
+	int indexOf(const Page* page) const;
+	int count() const;
+	void collect(vector<Page*>& pages) const;
+};
@@ -0,0 +1,104 @@
+#include "page columns.h"
+#include <algorithm>
+
+using namespace std;
+
+void PageColumns::reserve(size_t count)
+{
+	pages.reserve(count);
+	ids.reserve(count);
+	timestamps.reserve(count);
+	urls.reserve(count);
+	titles.reserve(count);
+	sessions.reserve(count);
+}
+
+uint32_t PageColumns::add(Page* page)
+{
+	uint32_t slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+		pages[slot] = page;
+		ids[slot] = page->getID();
+		timestamps[slot] = page->getTimestamp();
+		urls[slot] = page->getInternedUrl();
+		titles[slot] = page->getInternedTitle();
+		sessions[slot] = page->getInternedSessionID();
+	}
+	else
+	{
+		slot = (uint32_t)pages.size();
+		pages.push_back(page);
+		ids.push_back(page->getID());
+		timestamps.push_back(page->getTimestamp());
+		urls.push_back(page->getInternedUrl());
+		titles.push_back(page->getInternedTitle());
+		sessions.push_back(page->getInternedSessionID());
+	}
+
+	page->setColumnSlot(slot);
+	return slot;
+}
+
+void PageColumns::remove(uint32_t slot)
+{
+	if (slot >= pages.size() || pages[slot] == nullptr)
+	{
+		return;
+	}
+	pages[slot]->setColumnSlot(NO_SLOT);
+	pages[slot] = nullptr;
+	urls[slot] = nullptr;
+	titles[slot] = nullptr;
+	sessions[slot] = nullptr;
+	freeSlots.push_back(slot);
+}
+
+void PageColumns::clear()
+{
+	pages.clear();
+	ids.clear();
+	timestamps.clear();
+	urls.clear();
+	titles.clear();
+	sessions.clear();
+	freeSlots.clear();
+}
+
+const InternedString* PageColumns::urlAt(uint32_t slot) const
+{
+	return urls[slot];
+}
+
+const InternedString* PageColumns::titleAt(uint32_t slot) const
+{
+	return titles[slot];
+}
+
+const InternedString* PageColumns::sessionAt(uint32_t slot) const
+{
+	return sessions[slot];
+}
+
+void PageColumns::sortByAge(vector<uint32_t>& slots) const
+{
+	sort(slots.begin(), slots.end(), [this](uint32_t a, uint32_t b)
+	{
+		if (timestamps[a] != timestamps[b])
+		{
+			return timestamps[a] < timestamps[b];
+		}
+		return ids[a] < ids[b];
+	});
+}
+
+void PageColumns::collect(const vector<uint32_t>& slots, vector<Page*>& out) const
+{
+	out.reserve(out.size() + slots.size());
+	for (uint32_t slot : slots)
+	{
+		out.push_back(pages[slot]);
+	}
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <ctime>
+#include <atomic>
+#include <thread>
+#include <system_error>
+#include <limits>
+#include "page.h"
+
+using namespace std;
+
+// The fields that whole-history scans read, kept as parallel arrays indexed by each page's
+// column slot so a scan streams through a few dense arrays instead of visiting every Page.
+// Slots of removed pages are reused; a free slot has no page.
+class PageColumns
+{
+public:
+	static constexpr uint32_t NO_SLOT = 0xFFFFFFFFu;
+
+private:
+	vector<Page*> pages;
+	vector<unsigned int> ids;
+	vector<time_t> timestamps;
+	vector<const InternedString*> urls;
+	vector<const InternedString*> titles;
+	vector<const InternedString*> sessions;
+	vector<uint32_t> freeSlots;
+
+	template <typename Match>
+	bool scanRange(uint32_t first, uint32_t last, time_t low, time_t high, Match& match, vector<uint32_t>& slots, const atomic<bool>* cancelled) const;
+
+public:
+	void reserve(size_t count);
+	uint32_t add(Page* page);
+	void remove(uint32_t slot);
+	void clear();
+
+	const InternedString* urlAt(uint32_t slot) const;
+	const InternedString* titleAt(uint32_t slot) const;
+	const InternedString* sessionAt(uint32_t slot) const;
+
+	// Appends the slots of pages stamped within [startTime, endTime] for which match(slot) holds,
+	// in slot order; a zero bound is open. Returns false, leaving slots partly filled, if cancelled
+	// was raised. With threads above one, large stores are split into that many contiguous chunks
+	// scanned concurrently, so match must be safe to call from several threads at once.
+	template <typename Match>
+	bool scan(time_t startTime, time_t endTime, Match match, vector<uint32_t>& slots, const atomic<bool>* cancelled = nullptr, unsigned int threads = 1) const;
+	// Orders slots oldest first, the same way PageAgeOrder orders pages.
+	void sortByAge(vector<uint32_t>& slots) const;
+	void collect(const vector<uint32_t>& slots, vector<Page*>& pages) const;
+};
+
+template <typename Match>
+bool PageColumns::scanRange(uint32_t first, uint32_t last, time_t low, time_t high, Match& match, vector<uint32_t>& slots, const atomic<bool>* cancelled) const
+{
+	for (uint32_t slot = first; slot < last; slot++)
+	{
+		if (cancelled != nullptr && (slot & 4095) == 0 && cancelled->load())
+		{
+			return false;
+		}
+		time_t timestamp = timestamps[slot];
+		if (timestamp >= low && timestamp <= high && pages[slot] != nullptr && match(slot))
+		{
+			slots.push_back(slot);
+		}
+	}
+	return true;
+}
+
+template <typename Match>
+bool PageColumns::scan(time_t startTime, time_t endTime, Match match, vector<uint32_t>& slots, const atomic<bool>* cancelled, unsigned int threads) const
+{
+	time_t low = startTime > 0 ? startTime : numeric_limits<time_t>::min();
+	time_t high = endTime > 0 ? endTime : numeric_limits<time_t>::max();
+	uint32_t count = (uint32_t)timestamps.size();
+	// Below this many slots per chunk, starting a thread costs more than the chunk takes to scan.
+	const uint32_t minimumChunk = 16384;
+	if (threads > count / minimumChunk)
+	{
+		threads = count / minimumChunk;
+	}
+	if (threads <= 1)
+	{
+		return scanRange(0, count, low, high, match, slots, cancelled);
+	}
+
+	// Chunks are contiguous and appended in order, so the result matches a single-threaded scan.
+	uint32_t chunk = (count + threads - 1) / threads;
+	vector<vector<uint32_t>> chunkSlots(threads);
+	vector<char> completed(threads, 0);
+	auto scanChunk = [&](unsigned int index)
+	{
+		uint32_t first = index * chunk;
+		uint32_t last = first + chunk < count ? first + chunk : count;
+		completed[index] = scanRange(first, last, low, high, match, chunkSlots[index], cancelled);
+	};
+
+	{
+		// Joins whatever workers were started on every way out, so none is destroyed while joinable.
+		struct Workers
+		{
+			vector<thread> threads;
+			~Workers()
+			{
+				for (thread& worker : threads)
+				{
+					worker.join();
+				}
+			}
+		} workers;
+		workers.threads.reserve(threads - 1);
+		unsigned int started = 1;
+		try
+		{
+			for (; started < threads; started++)
+			{
+				workers.threads.emplace_back(scanChunk, started);
+			}
+		}
+		catch (const system_error&)
+		{
+			// Out of threads: the chunks that did not get one are scanned here instead.
+		}
+		scanChunk(0);
+		for (unsigned int index = started; index < threads; index++)
+		{
+			scanChunk(index);
+		}
+	}
+
+	size_t total = slots.size();
+	for (const vector<uint32_t>& part : chunkSlots)
+	{
+		total += part.size();
+	}
+	slots.reserve(total);
+	bool finished = true;
+	for (unsigned int index = 0; index < threads; index++)
+	{
+		slots.insert(slots.end(), chunkSlots[index].begin(), chunkSlots[index].end());
+		finished = finished && completed[index] != 0;
+	}
+	return finished;
+}
\ No newline at end of file
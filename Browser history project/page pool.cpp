@@ -0,0 +1,78 @@
+#include "page pool.h"
+
+using namespace std;
+
+PagePool::PagePool(size_t pagesPerSlab)
+	: slotsPerSlab(pagesPerSlab > 0 ? pagesPerSlab : 1), usedInLastSlab(0) {}
+
+PagePool::~PagePool()
+{
+	reset();
+	for (Slot* slab : slabs)
+	{
+		delete[] slab;
+	}
+}
+
+PagePool::Slot* PagePool::allocateSlot()
+{
+	if (!freeSlots.empty())
+	{
+		Slot* slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+	if (slabs.empty() || usedInLastSlab == slotsPerSlab)
+	{
+		slabs.push_back(new Slot[slotsPerSlab]);
+		usedInLastSlab = 0;
+	}
+	return &slabs.back()[usedInLastSlab++];
+}
+
+Page* PagePool::create(const InternedString* url, const InternedString* title, time_t timestamp, const InternedString* sessionID, const InternedString* host)
+{
+	Slot* slot = allocateSlot();
+	Page* page = new (slot->storage) Page(url, title, timestamp, sessionID, host);
+	slot->live = true;
+	return page;
+}
+
+void PagePool::destroy(Page* page)
+{
+	if (page == nullptr)
+	{
+		return;
+	}
+	Slot* slot = reinterpret_cast<Slot*>(page);
+	page->~Page();
+	slot->live = false;
+	freeSlots.push_back(slot);
+}
+
+void PagePool::reset()
+{
+	for (size_t i = 0; i < slabs.size(); i++)
+	{
+		size_t used = (i + 1 == slabs.size()) ? usedInLastSlab : slotsPerSlab;
+		for (size_t j = 0; j < used; j++)
+		{
+			Slot& slot = slabs[i][j];
+			if (slot.live)
+			{
+				reinterpret_cast<Page*>(slot.storage)->~Page();
+				slot.live = false;
+			}
+		}
+	}
+	for (size_t i = 1; i < slabs.size(); i++)
+	{
+		delete[] slabs[i];
+	}
+	if (!slabs.empty())
+	{
+		slabs.resize(1);
+	}
+	freeSlots.clear();
+	usedInLastSlab = 0;
+}
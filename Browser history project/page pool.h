@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include "page.h"
+
+using namespace std;
+
+class PagePool
+{
+private:
+	struct Slot
+	{
+		alignas(Page) unsigned char storage[sizeof(Page)];
+		bool live;
+	};
+
+	vector<Slot*> slabs;
+	vector<Slot*> freeSlots;
+	size_t slotsPerSlab;
+	size_t usedInLastSlab;
+
+	Slot* allocateSlot();
+
+public:
+	PagePool(size_t pagesPerSlab = 1024);
+	~PagePool();
+	PagePool(const PagePool&) = delete;
+	PagePool& operator=(const PagePool&) = delete;
+
+	Page* create(const InternedString* url, const InternedString* title, time_t timestamp, const InternedString* sessionID, const InternedString* host);
+	void destroy(Page* page);
+	void reset();
+};
@@ -0,0 +1,9 @@
+#include "page traversal.h"
+
+using namespace std;
+
+PageWalker& PageWalker::local()
+{
+	static thread_local PageWalker walker;
+	return walker;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include "page.h"
+
+using namespace std;
+
+// Iterative walks over a page tree. The stack is kept between walks so a
+// walker that has warmed up does not allocate. Each walk only touches the entries it
+// pushed itself, so a visitor may start another walk on the same walker.
+class PageWalker
+{
+public:
+	enum class Step { Descend, Skip, Stop };
+
+private:
+	struct Frame
+	{
+		Page* page;
+		size_t nextChild;
+	};
+
+	vector<Frame> stack;
+
+public:
+	static PageWalker& local();
+
+	// enter(page, depth) returns a Step; leave(page) returns false to stop.
+	template <typename Enter, typename Leave>
+	bool depthFirst(Page* root, Enter enter, Leave leave);
+
+	// visit(page, depth) returns false to stop.
+	template <typename Visit>
+	bool preOrder(Page* root, Visit visit);
+
+	// visit(page) returns false to stop. Children are left before their parent, so the
+	// visitor may free the page it is given, but must not change the child list of a page
+	// the walk has not left yet.
+	template <typename Visit>
+	bool postOrder(Page* root, Visit visit);
+};
+
+template <typename Enter, typename Leave>
+bool PageWalker::depthFirst(Page* root, Enter enter, Leave leave)
+{
+	if (root == nullptr)
+	{
+		return true;
+	}
+	Step step = enter(root, 0);
+	if (step == Step::Stop)
+	{
+		return false;
+	}
+	if (step == Step::Skip)
+	{
+		return leave(root);
+	}
+
+	size_t base = stack.size();
+	bool completed = true;
+	stack.push_back({ root, 0 });
+	while (stack.size() > base)
+	{
+		Page* page = stack.back().page;
+		size_t next = stack.back().nextChild++;
+		const vector<Page*>& children = page->getChildren();
+		if (next < children.size())
+		{
+			Page* child = children[next];
+			step = enter(child, (int)(stack.size() - base));
+			if (step == Step::Stop)
+			{
+				completed = false;
+				break;
+			}
+			if (step == Step::Descend)
+			{
+				stack.push_back({ child, 0 });
+			}
+			else if (!leave(child))
+			{
+				completed = false;
+				break;
+			}
+		}
+		else
+		{
+			stack.pop_back();
+			if (!leave(page))
+			{
+				completed = false;
+				break;
+			}
+		}
+	}
+	stack.resize(base);
+	return completed;
+}
+
+template <typename Visit>
+bool PageWalker::preOrder(Page* root, Visit visit)
+{
+	return depthFirst(root,
+		[&](Page* page, int depth) { return visit(page, depth) ? Step::Descend : Step::Stop; },
+		[](Page*) { return true; });
+}
+
+template <typename Visit>
+bool PageWalker::postOrder(Page* root, Visit visit)
+{
+	return depthFirst(root,
+		[](Page*, int) { return Step::Descend; },
+		visit);
+}
@@ -4,25 +4,34 @@
 
 using namespace std;
 
-Page::Page(const string& url, const string& title, time_t timestamp, const string&sessionID)
-	: url(url), title(title), timestamp(timestamp), parent(nullptr), exitTime(0), scrollPosition(0), sessionID(sessionID) {}
+Page::Page(const InternedString* url, const InternedString* title, time_t timestamp, const InternedString* sessionID, const InternedString* host)
+	: id(0), orderSlot(-1), columnSlot(0xFFFFFFFFu), viewHandle(nullptr), url(url), title(title), timestamp(timestamp), parent(nullptr), exitTime(0), scrollPosition(0), sessionID(sessionID), host(host) {}
 
-Page::~Page()
+Page::~Page() {}
+
+unsigned int Page::getID() const
 {
-	for (Page* child : children)
-	{
-		delete child;
-	}
-	children.clear();
+	return id;
 }
-
-string Page::getUrl() const 
+int Page::getOrderSlot() const
 {
-	return url;
+	return orderSlot;
 }
-string Page::getTitle() const
+unsigned int Page::getColumnSlot() const
 {
-	return title;
+	return columnSlot;
+}
+void* Page::getViewHandle() const
+{
+	return viewHandle;
+}
+const string& Page::getUrl() const 
+{
+	return *url->text;
+}
+const string& Page::getTitle() const
+{
+	return *title->text;
 }
 time_t Page::getTimestamp() const
 {
@@ -48,11 +57,15 @@ int Page::getScrollPosition() const
 {
 	return scrollPosition;
 }
-string Page::getSessionID() const
+const string& Page::getSessionID() const
 {
-	return sessionID;
+	return *sessionID->text;
 }
-map<string, string> Page::getFormData() const
+const string& Page::getHost() const
+{
+	return *host->text;
+}
+const map<string, string>& Page::getFormData() const
 {
 	return formData;
 }
@@ -60,7 +73,39 @@ const vector<Page*>& Page::getChildren() const
 {
 	return children;
 }
+const InternedString* Page::getInternedUrl() const
+{
+	return url;
+}
+const InternedString* Page::getInternedTitle() const
+{
+	return title;
+}
+const InternedString* Page::getInternedSessionID() const
+{
+	return sessionID;
+}
+const InternedString* Page::getInternedHost() const
+{
+	return host;
+}
 
+void Page::setID(unsigned int id)
+{
+	this->id = id;
+}
+void Page::setOrderSlot(int slot)
+{
+	orderSlot = slot;
+}
+void Page::setColumnSlot(unsigned int slot)
+{
+	columnSlot = slot;
+}
+void Page::setViewHandle(void* handle)
+{
+	viewHandle = handle;
+}
 void Page::setParent(Page* parent)
 {
 	this->parent = parent;
@@ -89,12 +134,11 @@ void Page::setFormData(const string& key, const string& value)
 	formData[key] = value;
 }
 
-Page* Page::addChild(const string& url, const string& title, time_t timestamp, const string& sessionID)
+Page* Page::addChild(Page* child)
 {
-	Page* newPage = new Page(url, title, timestamp, sessionID);
-	newPage->setParent(this);
-	children.push_back(newPage);
-	return newPage;
+	child->setParent(this);
+	children.push_back(child);
+	return child;
 }
 
 bool Page::removeChild(Page* child)
@@ -103,22 +147,24 @@ bool Page::removeChild(Page* child)
 	if (it != children.end())
 	{
 		children.erase(it);
-		delete child;
+		child->setParent(nullptr);
 		return true;
 	}
 	return false;
 }
 
-Page* Page::findChild(const string& url) const
+void Page::removeChildren(const unordered_set<Page*>& removed)
 {
-	for (Page* child : children)
+	auto kept = remove_if(children.begin(), children.end(), [&](Page* child)
 	{
-		if (child->url == url)
+		if (removed.count(child) == 0)
 		{
-			return child;
+			return false;
 		}
-	}
-	return nullptr;
+		child->setParent(nullptr);
+		return true;
+	});
+	children.erase(kept, children.end());
 }
 
 int Page::childCount() const
@@ -129,8 +175,8 @@ int Page::childCount() const
 string Page::toString() const
 {
 	stringstream ss;
-	ss << "URL: " << url << "\n";
-	ss << "Title: " << title << "\n";
+	ss << "URL: " << *url->text << "\n";
+	ss << "Title: " << *title->text << "\n";
 	ss << "Timestamp: " << timestamp << "\n";
 	return ss.str();
 
@@ -157,9 +203,9 @@ string Page::toString() const
 
 	ss << "\nScroll Position: " << scrollPosition;
 
-	if (!sessionID.empty())
+	if (!sessionID->text->empty())
 	{
-		ss << "\nSession ID: " << sessionID;
+		ss << "\nSession ID: " << *sessionID->text;
 	}
 
 	if (!formData.empty())
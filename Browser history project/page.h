@@ -4,37 +4,57 @@
 #include <ctime>
 #include <map>
 #include <vector>
+#include <unordered_set>
+#include "string table.h"
 
 using namespace std;
 
 class Page
 {
 private:
-	string url;
+	unsigned int id;
+	int orderSlot;
+	unsigned int columnSlot;
+	void* viewHandle;
+	const InternedString* url;
 	time_t timestamp;
-	string title;
+	const InternedString* title;
 	Page* parent;
 	vector<Page*> children;
 	time_t exitTime;
 	int scrollPosition;
-	string sessionID;
+	const InternedString* sessionID;
+	const InternedString* host;
 	map<string, string> formData;
 public:
-	Page(const string& url, const string& title, time_t timestamp, const string& sessionID = "");
+	Page(const InternedString* url, const InternedString* title, time_t timestamp, const InternedString* sessionID, const InternedString* host);
 	~Page();
 
-	string getUrl() const;
-	string getTitle() const;
+	unsigned int getID() const;
+	int getOrderSlot() const;
+	unsigned int getColumnSlot() const;
+	void* getViewHandle() const;
+	const string& getUrl() const;
+	const string& getTitle() const;
 	time_t getTimestamp() const;
 	Page* getParent() const;
 	Page* getPrev() const;
 	Page* getNext() const;
 	time_t getExitTime() const;
 	int getScrollPosition() const;
-	string getSessionID() const;
-	map<string, string> getFormData() const;
+	const string& getSessionID() const;
+	const string& getHost() const;
+	const map<string, string>& getFormData() const;
 	const vector<Page*>& getChildren() const;
+	const InternedString* getInternedUrl() const;
+	const InternedString* getInternedTitle() const;
+	const InternedString* getInternedSessionID() const;
+	const InternedString* getInternedHost() const;
 
+	void setID(unsigned int id);
+	void setOrderSlot(int slot);
+	void setColumnSlot(unsigned int slot);
+	void setViewHandle(void* handle);
 	void setParent(Page* parent);
 	void setPrev(Page* prev);
 	void setNext(Page* next);
@@ -42,9 +62,10 @@ public:
 	void setScrollPosition(int position);
 	void setFormData(const string& key, const string& value);
 
-	Page* addChild(const string& url, const string& title, time_t timestamp, const string& sessionID = "");
+	Page* addChild(Page* child);
 	bool removeChild(Page* child);
-	Page* findChild(const string& url) const;
+	// Drops every child in the set with one pass over the child list.
+	void removeChildren(const unordered_set<Page*>& removed);
 	int childCount() const;
 
 	string toString() const;
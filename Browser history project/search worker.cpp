@@ -0,0 +1,84 @@
+#include "search worker.h"
+
+using namespace std;
+
+SearchWorker::SearchWorker(ConcurrentHistory& history, ResultCallback onResults)
+	: history(history), onResults(onResults), hasPending(false), stopping(false), lastGeneration(0), cancelled(false)
+{
+	worker = thread(&SearchWorker::run, this);
+}
+
+SearchWorker::~SearchWorker()
+{
+	{
+		lock_guard<mutex> lock(queueMutex);
+		stopping = true;
+		cancelled = true;
+	}
+	wakeUp.notify_one();
+	worker.join();
+}
+
+unsigned int SearchWorker::submit(const string& titleSubstring, const string& urlSubstring, const string& sessionID)
+{
+	unsigned int generation;
+	{
+		lock_guard<mutex> lock(queueMutex);
+		generation = ++lastGeneration;
+		pendingQuery.generation = generation;
+		pendingQuery.titleSubstring = titleSubstring;
+		pendingQuery.urlSubstring = urlSubstring;
+		pendingQuery.sessionID = sessionID;
+		hasPending = true;
+		cancelled = true;
+	}
+	wakeUp.notify_one();
+	return generation;
+}
+
+void SearchWorker::cancelRunning()
+{
+	cancelled = true;
+}
+
+void SearchWorker::run()
+{
+	unique_lock<mutex> lock(queueMutex);
+	while (true)
+	{
+		wakeUp.wait(lock, [this] { return stopping || hasPending; });
+		if (stopping)
+		{
+			return;
+		}
+		SearchQuery query = pendingQuery;
+		hasPending = false;
+		cancelled = false;
+		lock.unlock();
+
+		vector<unsigned int> pageIDs = history.read([&](const BrowserHistory& engine)
+		{
+			vector<Page*> pages = engine.searchPages(query.titleSubstring, query.urlSubstring, query.sessionID, 0, 0, &cancelled);
+			vector<unsigned int> ids;
+			ids.reserve(pages.size());
+			for (Page* page : pages)
+			{
+				ids.push_back(page->getID());
+			}
+			return ids;
+		});
+
+		bool completed = !cancelled;
+		if (completed)
+		{
+			onResults(query.generation, pageIDs);
+		}
+
+		lock.lock();
+		if (!completed && !hasPending && !stopping)
+		{
+			pendingQuery = query;
+			hasPending = true;
+		}
+	}
+}
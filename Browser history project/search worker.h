@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include "concurrent history.h"
+
+using namespace std;
+
+struct SearchQuery
+{
+	unsigned int generation;
+	string titleSubstring;
+	string urlSubstring;
+	string sessionID;
+};
+
+class SearchWorker
+{
+public:
+	typedef function<void(unsigned int generation, const vector<unsigned int>& pageIDs)> ResultCallback;
+
+private:
+	ConcurrentHistory& history;
+	ResultCallback onResults;
+
+	thread worker;
+	mutex queueMutex;
+	condition_variable wakeUp;
+	SearchQuery pendingQuery;
+	bool hasPending;
+	bool stopping;
+	unsigned int lastGeneration;
+	atomic<bool> cancelled;
+
+	void run();
+
+public:
+	SearchWorker(ConcurrentHistory& history, ResultCallback onResults);
+	~SearchWorker();
+	SearchWorker(const SearchWorker&) = delete;
+	SearchWorker& operator=(const SearchWorker&) = delete;
+
+	unsigned int submit(const string& titleSubstring, const string& urlSubstring = "", const string& sessionID = "");
+	void cancelRunning();
+};
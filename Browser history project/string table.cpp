@@ -0,0 +1,91 @@
+#include "string table.h"
+#include "text search.h"
+
+using namespace std;
+
+const string& InternedString::lower() const
+{
+	return folded.empty() ? *text : folded;
+}
+
+const InternedString* StringTable::intern(const string& text)
+{
+	auto existing = strings.find(text);
+	if (existing != strings.end())
+	{
+		existing->second.references++;
+		return &existing->second;
+	}
+	auto result = strings.emplace(text, InternedString{ nullptr, string(), 0 });
+	InternedString& entry = result.first->second;
+	if (result.second)
+	{
+		entry.text = &result.first->first;
+		if (!isFolded(text))
+		{
+			entry.folded = foldCase(text);
+		}
+	}
+	entry.references++;
+	return &entry;
+}
+
+const InternedString* StringTable::intern(string&& text)
+{
+	auto result = strings.try_emplace(move(text), InternedString{ nullptr, string(), 0 });
+	InternedString& entry = result.first->second;
+	if (result.second)
+	{
+		const string& stored = result.first->first;
+		entry.text = &stored;
+		if (!isFolded(stored))
+		{
+			entry.folded = foldCase(stored);
+		}
+	}
+	entry.references++;
+	return &entry;
+}
+
+const InternedString* StringTable::retain(const InternedString* str)
+{
+	if (str != nullptr)
+	{
+		const_cast<InternedString*>(str)->references++;
+	}
+	return str;
+}
+
+const InternedString* StringTable::find(const string& text) const
+{
+	auto it = strings.find(text);
+	return it == strings.end() ? nullptr : &it->second;
+}
+
+void StringTable::release(const InternedString* str)
+{
+	if (str == nullptr)
+	{
+		return;
+	}
+	InternedString* entry = const_cast<InternedString*>(str);
+	if (--entry->references <= 0)
+	{
+		strings.erase(*entry->text);
+	}
+}
+
+void StringTable::clear()
+{
+	strings.clear();
+}
+
+void StringTable::reserve(size_t count)
+{
+	strings.reserve(count);
+}
+
+size_t StringTable::count() const
+{
+	return strings.size();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+struct InternedString
+{
+	const string* text;
+	string folded;
+	int references;
+
+	const string& lower() const;
+};
+
+class StringTable
+{
+private:
+	unordered_map<string, InternedString> strings;
+
+public:
+	const InternedString* intern(const string& text);
+	const InternedString* intern(string&& text);
+	const InternedString* retain(const InternedString* str);
+	const InternedString* find(const string& text) const;
+	void release(const InternedString* str);
+	void clear();
+	void reserve(size_t count);
+	size_t count() const;
+};
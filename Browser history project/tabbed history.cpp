@@ -0,0 +1,163 @@
+#include "tabbed history.h"
+
+using namespace std;
+
+TabbedHistory::TabbedHistory(int maxHistorySize)
+	: history(maxHistorySize), activeTab(0), nextTabID(1)
+{
+	history.addObserver(this);
+}
+
+TabbedHistory::~TabbedHistory()
+{
+	history.removeObserver(this);
+}
+
+void TabbedHistory::parkActiveTab()
+{
+	if (activeTab == 0)
+	{
+		return;
+	}
+	Page* cursor = history.getCurrentPage();
+	tabs[activeTab] = cursor;
+	history.pinPage(cursor);
+}
+
+unsigned int TabbedHistory::openTab(const string& url, const string& title)
+{
+	parkActiveTab();
+	Page* opener = history.getCurrentPage();
+	if (opener == nullptr)
+	{
+		history.addPage(url, title);
+	}
+	else
+	{
+		// addPage would cut off the opener's forward branch, which still belongs to its tab.
+		history.goToPage(history.insertPage(opener, url, title, history.currentTime()));
+		history.pruneOldestPages();
+	}
+	activeTab = nextTabID++;
+	tabs[activeTab] = nullptr;
+	return activeTab;
+}
+
+bool TabbedHistory::closeTab(unsigned int tabID)
+{
+	auto tab = tabs.find(tabID);
+	if (tab == tabs.end())
+	{
+		return false;
+	}
+	if (tabID != activeTab)
+	{
+		history.unpinPage(tab->second);
+		tabs.erase(tab);
+		return true;
+	}
+
+	tabs.erase(tab);
+	activeTab = 0;
+	if (tabs.empty())
+	{
+		history.goToHome();
+		return true;
+	}
+	auto next = tabs.begin();
+	activeTab = next->first;
+	history.unpinPage(next->second);
+	history.goToPage(next->second);
+	next->second = nullptr;
+	return true;
+}
+
+bool TabbedHistory::switchToTab(unsigned int tabID)
+{
+	auto tab = tabs.find(tabID);
+	if (tab == tabs.end())
+	{
+		return false;
+	}
+	if (tabID == activeTab)
+	{
+		return true;
+	}
+
+	parkActiveTab();
+	Page* cursor = tab->second;
+	history.unpinPage(cursor);
+	history.goToPage(cursor);
+	tab->second = nullptr;
+	activeTab = tabID;
+	return true;
+}
+
+unsigned int TabbedHistory::getActiveTab() const
+{
+	return activeTab;
+}
+
+int TabbedHistory::getTabCount() const
+{
+	return (int)tabs.size();
+}
+
+vector<unsigned int> TabbedHistory::listTabs() const
+{
+	vector<unsigned int> tabIDs;
+	tabIDs.reserve(tabs.size());
+	for (const auto& tab : tabs)
+	{
+		tabIDs.push_back(tab.first);
+	}
+	return tabIDs;
+}
+
+Page* TabbedHistory::getTabPage(unsigned int tabID) const
+{
+	if (tabID == activeTab && activeTab != 0)
+	{
+		return history.getCurrentPage();
+	}
+	auto tab = tabs.find(tabID);
+	return tab != tabs.end() ? tab->second : nullptr;
+}
+
+BrowserHistory& TabbedHistory::getHistory()
+{
+	return history;
+}
+
+const BrowserHistory& TabbedHistory::getHistory() const
+{
+	return history;
+}
+
+void TabbedHistory::onPageRemoving(Page* page)
+{
+	// Eviction never reaches a parked cursor, but replayRemovePage can. A tab whose page goes with
+	// the removed subtree falls back to the subtree's parent. Evicted pages are leaves, so for them
+	// only a tab parked on the page itself needs checking.
+	bool leaf = page->getChildren().empty();
+	for (auto& tab : tabs)
+	{
+		Page* ancestor = tab.second;
+		while (!leaf && ancestor != nullptr && ancestor != page)
+		{
+			ancestor = ancestor->getParent();
+		}
+		if (ancestor == page)
+		{
+			history.unpinPage(tab.second);
+			tab.second = page->getParent();
+			history.pinPage(tab.second);
+		}
+	}
+}
+
+void TabbedHistory::onHistoryCleared()
+{
+	tabs.clear();
+	activeTab = 0;
+}
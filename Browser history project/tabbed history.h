@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include "browser history.h"
+#include "history observer.h"
+
+using namespace std;
+
+// Many tabs over one BrowserHistory. Pages, interned strings, indexes and the size limit are
+// shared; each tab only keeps its own cursor. The active tab's cursor is the history's current
+// page, and the cursors of the other tabs are pinned so they survive eviction. With no tabs open
+// the history's cursor rests on the root, so no closed tab's branch is held back from eviction.
+class TabbedHistory : public HistoryObserver
+{
+private:
+	BrowserHistory history;
+	map<unsigned int, Page*> tabs;
+	unsigned int activeTab;
+	unsigned int nextTabID;
+
+	void parkActiveTab();
+
+public:
+	TabbedHistory(int maxHistorySize = 50);
+	~TabbedHistory();
+	TabbedHistory(const TabbedHistory&) = delete;
+	TabbedHistory& operator=(const TabbedHistory&) = delete;
+
+	// A tab opened while another is active starts as a child of that tab's current page; with no
+	// tab open it starts as a child of the root.
+	unsigned int openTab(const string& url, const string& title);
+	bool closeTab(unsigned int tabID);
+	bool switchToTab(unsigned int tabID);
+
+	unsigned int getActiveTab() const;
+	int getTabCount() const;
+	vector<unsigned int> listTabs() const;
+	Page* getTabPage(unsigned int tabID) const;
+
+	BrowserHistory& getHistory();
+	const BrowserHistory& getHistory() const;
+
+	void onPageRemoving(Page* page) override;
+	void onHistoryCleared() override;
+};
@@ -0,0 +1,119 @@
+#include "text search.h"
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXT_SEARCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+static inline char foldChar(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+string foldCase(const string& text)
+{
+	string folded(text);
+	for (char& c : folded)
+	{
+		c = foldChar(c);
+	}
+	return folded;
+}
+
+bool isFolded(const string& text)
+{
+	for (char c : text)
+	{
+		if (foldChar(c) != c)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+#ifdef TEXT_SEARCH_SSE2
+static inline unsigned lowestBit(unsigned mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+bool containsFolded(const string& foldedText, const string& foldedPattern)
+{
+	return containsFolded(foldedText.data(), foldedText.size(), foldedPattern);
+}
+
+bool containsFolded(const char* text, size_t textLength, const string& foldedPattern)
+{
+	size_t patternLength = foldedPattern.size();
+	if (patternLength == 0)
+	{
+		return true;
+	}
+	if (patternLength > textLength)
+	{
+		return false;
+	}
+	size_t start = 0;
+#ifdef TEXT_SEARCH_SSE2
+	if (patternLength > 1)
+	{
+		const char* pattern = foldedPattern.data();
+		const __m128i first = _mm_set1_epi8(pattern[0]);
+		const __m128i last = _mm_set1_epi8(pattern[patternLength - 1]);
+		for (; start + patternLength + 15 <= textLength; start += 16)
+		{
+			__m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + start));
+			__m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + start + patternLength - 1));
+			unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+			while (mask != 0)
+			{
+				unsigned offset = lowestBit(mask);
+				if (memcmp(text + start + offset + 1, pattern + 1, patternLength - 2) == 0)
+				{
+					return true;
+				}
+				mask &= mask - 1;
+			}
+		}
+	}
+#endif
+	return string_view(text, textLength).find(foldedPattern, start) != string_view::npos;
+}
+
+bool containsIgnoreCase(const string& text, const string& pattern)
+{
+	size_t patternLength = pattern.size();
+	if (patternLength > text.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i + patternLength <= text.size(); i++)
+	{
+		size_t j = 0;
+		while (j < patternLength && foldChar(text[i + j]) == foldChar(pattern[j]))
+		{
+			j++;
+		}
+		if (j == patternLength)
+		{
+			return true;
+		}
+	}
+	return false;
+}
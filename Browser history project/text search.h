@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+string foldCase(const string& text);
+// True when foldCase would return the text unchanged.
+bool isFolded(const string& text);
+bool containsFolded(const string& foldedText, const string& foldedPattern);
+bool containsFolded(const char* foldedText, size_t textLength, const string& foldedPattern);
+bool containsIgnoreCase(const string& text, const string& pattern);
@@ -0,0 +1,90 @@
+#include "trigram index.h"
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+TrigramIndex::TrigramIndex()
+	: entryCount(0), staleCount(0) {}
+
+void TrigramIndex::extractTrigrams(const string& text, vector<unsigned int>& trigrams)
+{
+	trigrams.clear();
+	for (size_t i = 0; i + 3 <= text.size(); i++)
+	{
+		trigrams.push_back(((unsigned int)(unsigned char)text[i] << 16) | ((unsigned int)(unsigned char)text[i + 1] << 8) | (unsigned char)text[i + 2]);
+	}
+	sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(unique(trigrams.begin(), trigrams.end()), trigrams.end());
+}
+
+void TrigramIndex::add(unsigned int id, const string& foldedText)
+{
+	vector<unsigned int> trigrams;
+	extractTrigrams(foldedText, trigrams);
+	for (unsigned int trigram : trigrams)
+	{
+		vector<unsigned int>& ids = postings[trigram];
+		if (ids.empty() || ids.back() < id)
+		{
+			ids.push_back(id);
+		}
+		else
+		{
+			ids.insert(lower_bound(ids.begin(), ids.end(), id), id);
+		}
+	}
+	entryCount += trigrams.size();
+}
+
+void TrigramIndex::remove(const string& foldedText)
+{
+	vector<unsigned int> trigrams;
+	extractTrigrams(foldedText, trigrams);
+	staleCount += trigrams.size();
+}
+
+bool TrigramIndex::lookup(const string& foldedPattern, vector<unsigned int>& ids) const
+{
+	ids.clear();
+	vector<unsigned int> trigrams;
+	extractTrigrams(foldedPattern, trigrams);
+	if (trigrams.empty())
+	{
+		return false;
+	}
+
+	vector<const vector<unsigned int>*> lists;
+	for (unsigned int trigram : trigrams)
+	{
+		auto it = postings.find(trigram);
+		if (it == postings.end())
+		{
+			return true;
+		}
+		lists.push_back(&it->second);
+	}
+	sort(lists.begin(), lists.end(), [](const vector<unsigned int>* a, const vector<unsigned int>* b) { return a->size() < b->size(); });
+
+	ids = *lists[0];
+	vector<unsigned int> narrowed;
+	for (size_t i = 1; i < lists.size() && !ids.empty(); i++)
+	{
+		narrowed.clear();
+		set_intersection(ids.begin(), ids.end(), lists[i]->begin(), lists[i]->end(), back_inserter(narrowed));
+		ids.swap(narrowed);
+	}
+	return true;
+}
+
+bool TrigramIndex::needsRebuild() const
+{
+	return staleCount > 4096 && staleCount * 2 > entryCount;
+}
+
+void TrigramIndex::clear()
+{
+	postings.clear();
+	entryCount = 0;
+	staleCount = 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+class TrigramIndex
+{
+private:
+	unordered_map<unsigned int, vector<unsigned int>> postings;
+	size_t entryCount;
+	size_t staleCount;
+
+	static void extractTrigrams(const string& text, vector<unsigned int>& trigrams);
+
+public:
+	TrigramIndex();
+
+	void add(unsigned int id, const string& foldedText);
+	void remove(const string& foldedText);
+	bool lookup(const string& foldedPattern, vector<unsigned int>& ids) const;
+	bool needsRebuild() const;
+	void clear();
+};
@@ -3,6 +3,11 @@
 #include <wx/datetime.h>
 #include <sstream>
 #include <wx/valtext.h>
+#include <wx/filedlg.h>
+#include "history import.h"
+#include "page traversal.h"
+
+static const char* const HISTORY_FILE = "history.bhst";
 
 enum
 {
@@ -17,7 +22,8 @@ enum
     ID_NewSession,
     ID_ClearHistory,
     ID_URL_BAR,
-    ID_SEARCH_BAR
+    ID_SEARCH_BAR,
+    ID_Import
 
 };
 
@@ -32,8 +38,11 @@ EVT_BUTTON(ID_NewSession, BrowserHistoryFrame::OnNewSessionButton)
 EVT_BUTTON(ID_ClearHistory, BrowserHistoryFrame::OnClearHistoryButton)
 EVT_TREE_SEL_CHANGED(ID_HistoryTree, BrowserHistoryFrame::OnTreeSelectionChanged)
 EVT_TREE_ITEM_ACTIVATED(ID_HistoryTree, BrowserHistoryFrame::OnTreeItemActivated)
+EVT_TREE_ITEM_EXPANDING(ID_HistoryTree, BrowserHistoryFrame::OnTreeItemExpanding)
+EVT_TREE_ITEM_COLLAPSED(ID_HistoryTree, BrowserHistoryFrame::OnTreeItemCollapsed)
 EVT_MENU(wxID_EXIT, BrowserHistoryFrame::OnExit)
 EVT_MENU(wxID_ABOUT, BrowserHistoryFrame::OnAbout)
+EVT_MENU(ID_Import, BrowserHistoryFrame::OnImport)
 END_EVENT_TABLE()
 
 IMPLEMENT_APP(BrowserHistoryApp)
@@ -48,9 +57,11 @@ bool BrowserHistoryApp::OnInit()
 }
 
 BrowserHistoryFrame::BrowserHistoryFrame(const wxString& title)
-    : wxFrame(NULL, wxID_ANY, title), m_pageViewFrame(nullptr)
+    : wxFrame(NULL, wxID_ANY, title), m_searchWorker(nullptr), m_journal(nullptr), m_journalTimer(this), m_lastSearch(0), m_dialogSearch(0), m_pageViewFrame(nullptr)
 {
     wxMenu* menuFile = new wxMenu;
+    menuFile->Append(ID_Import, "&Import History...\tCtrl-I", "Load pages from a TSV or JSON Lines history dump");
+    menuFile->AppendSeparator();
     menuFile->Append(wxID_EXIT, "E&xit\tAlt-X", "Quit this program");
 
     wxMenu* menuHelp = new wxMenu;
@@ -72,12 +83,28 @@ BrowserHistoryFrame::BrowserHistoryFrame(const wxString& title)
 
     UpdateHistoryTree();
     RefreshNavigationButtons();
+
+    m_history->addObserver(this);
+
+    m_searchWorker = new SearchWorker(*m_sharedHistory,
+        [this](unsigned int generation, const vector<unsigned int>& pageIDs) {
+            CallAfter([this, generation, pageIDs]() { OnSearchResults(generation, pageIDs); });
+        });
+
+    Bind(wxEVT_TIMER, &BrowserHistoryFrame::OnJournalTimer, this);
+    m_journalTimer.Start(1000);
 }
 
 BrowserHistoryFrame::~BrowserHistoryFrame()
 {
-    if (m_history)
-        delete m_history;
+    m_journalTimer.Stop();
+    delete m_searchWorker;
+    delete m_journal;
+
+    if (m_history) {
+        m_history->removeObserver(this);
+        delete m_sharedHistory;
+    }
 
     if (m_pageViewFrame)
         m_pageViewFrame->Destroy();
@@ -183,11 +210,22 @@ void BrowserHistoryFrame::BindEvents()
 {
     m_urlBar->Bind(wxEVT_COMMAND_TEXT_ENTER, &BrowserHistoryFrame::OnGoButton, this);
     m_searchBar->Bind(wxEVT_COMMAND_TEXT_ENTER, &BrowserHistoryFrame::OnSearchButton, this);
+    m_searchBar->Bind(wxEVT_TEXT, &BrowserHistoryFrame::OnSearchTextChanged, this);
 }
 
 void BrowserHistoryFrame::InitializeHistory()
 {
-    m_history = new BrowserHistory(100);
+    m_sharedHistory = new ConcurrentHistory(100);
+    m_history = &m_sharedHistory->engine();
+    m_history->setSearchIndexEnabled(true);
+
+    m_journal = new HistoryJournal(*m_history, HISTORY_FILE);
+    if (!m_journal->open()) {
+        wxMessageBox(wxString("Could not read the saved history in ") + HISTORY_FILE + ". Changes made now will not be saved.", "Browser History", wxOK | wxICON_WARNING);
+    }
+    if (m_history->getRootPage()) {
+        return;
+    }
 
     m_history->addPage("https://www.example.com", "Example Home");
     m_history->addPage("https://www.example.com/about", "About Example");
@@ -207,38 +245,149 @@ void BrowserHistoryFrame::InitializeHistory()
 
 void BrowserHistoryFrame::UpdateHistoryTree()
 {
+    Page* rootPage = m_history->getRootPage();
+    if (rootPage) {
+        ForgetChildItems(rootPage);
+        rootPage->setViewHandle(nullptr);
+    }
     m_historyTree->DeleteAllItems();
-    m_pageToTreeItem.clear();
 
     m_rootId = m_historyTree->AddRoot("Root");
 
-    Page* rootPage = m_history->getCurrentPage();
-    while (rootPage->getParent() != nullptr) {
-        rootPage = rootPage->getParent();
+    if (!rootPage) {
+        UpdatePageDetails(nullptr);
+        return;
     }
 
-    PopulateTree(rootPage, m_rootId);
-    m_historyTree->ExpandAll();
+    AppendPageItem(rootPage, m_rootId);
 
     HighlightCurrentPage();
 }
 
-void BrowserHistoryFrame::PopulateTree(Page* page, const wxTreeItemId& parentId)
+void BrowserHistoryFrame::onPageAdded(Page* page)
 {
-    if (!page) return;
+    Page* parent = page->getParent();
+    if (!parent) {
+        if (m_historyTree->GetChildrenCount(m_rootId, false) == 0) {
+            AppendPageItem(page, m_rootId);
+        }
+        return;
+    }
+
+    wxTreeItemId parentId = GetTreeItemFromPage(parent);
+    if (!parentId.IsOk()) return;
+
+    if (m_historyTree->GetChildrenCount(parentId, false) > 0) {
+        AppendPageItem(page, parentId);
+    }
+    else {
+        m_historyTree->SetItemHasChildren(parentId, true);
+    }
+}
 
+void BrowserHistoryFrame::onPageRemoving(Page* page)
+{
+    wxTreeItemId itemId = GetTreeItemFromPage(page);
+    if (!itemId.IsOk()) return;
+
+    ForgetChildItems(page);
+    page->setViewHandle(nullptr);
+    m_historyTree->Delete(itemId);
+
+    // Eviction detaches pages from their parent only after notifying, so count the tree's items
+    // instead; a removed page had an item, so its parent's children are all populated.
+    Page* parent = page->getParent();
+    if (parent) {
+        wxTreeItemId parentId = GetTreeItemFromPage(parent);
+        if (parentId.IsOk() && m_historyTree->GetChildrenCount(parentId, false) == 0) {
+            m_historyTree->SetItemHasChildren(parentId, false);
+        }
+    }
+}
+
+void BrowserHistoryFrame::onCurrentPageChanged(Page* previous, Page* current)
+{
+    HighlightCurrentPage();
+}
+
+void BrowserHistoryFrame::onHistoryCleared()
+{
+    m_historyTree->DeleteChildren(m_rootId);
+    UpdatePageDetails(nullptr);
+}
+
+bool BrowserHistoryFrame::wantsBatchedEvents() const
+{
+    return false;
+}
+
+void BrowserHistoryFrame::onBatchCommitted()
+{
+    UpdateHistoryTree();
+    RefreshNavigationButtons();
+}
+
+wxTreeItemId BrowserHistoryFrame::AppendPageItem(Page* page, const wxTreeItemId& parentId)
+{
     wxString itemText = wxString::Format("%s (%s)",
         wxString(page->getTitle()),
         wxString(page->getUrl()));
 
-    wxTreeItemId itemId = m_historyTree->AppendItem(parentId, itemText);
+    wxTreeItemId itemId = m_historyTree->AppendItem(parentId, itemText, -1, -1, new PageItemData(page));
+    m_historyTree->SetItemHasChildren(itemId, !page->getChildren().empty());
+
+    page->setViewHandle(itemId.GetID());
+    return itemId;
+}
 
-    m_pageToTreeItem[page] = itemId;
+void BrowserHistoryFrame::PopulateChildren(Page* page, const wxTreeItemId& itemId)
+{
+    if (!page || m_historyTree->GetChildrenCount(itemId, false) > 0) return;
+
+    for (Page* child : page->getChildren()) {
+        AppendPageItem(child, itemId);
+    }
+}
+
+void BrowserHistoryFrame::ForgetChildItems(Page* page)
+{
+    PageWalker::local().depthFirst(page,
+        [page](Page* visited, int) {
+            if (visited == page) {
+                return PageWalker::Step::Descend;
+            }
+            if (!visited->getViewHandle()) {
+                return PageWalker::Step::Skip;
+            }
+            visited->setViewHandle(nullptr);
+            return PageWalker::Step::Descend;
+        },
+        [](Page*) { return true; });
+}
+
+wxTreeItemId BrowserHistoryFrame::ShowPageItem(Page* page)
+{
+    vector<Page*> hidden;
+    Page* shown = page;
+    while (shown && !shown->getViewHandle()) {
+        hidden.push_back(shown);
+        shown = shown->getParent();
+    }
+
+    if (!shown) {
+        shown = hidden.back();
+        hidden.pop_back();
+        AppendPageItem(shown, m_rootId);
+    }
 
-    const vector<Page*>& children = page->getChildren();
-    for (Page* child : children) {
-        PopulateTree(child, itemId);
+    wxTreeItemId itemId = GetTreeItemFromPage(shown);
+    while (!hidden.empty()) {
+        PopulateChildren(shown, itemId);
+        shown = hidden.back();
+        hidden.pop_back();
+        itemId = GetTreeItemFromPage(shown);
     }
+    return itemId;
 }
 
 void BrowserHistoryFrame::HighlightCurrentPage()
@@ -246,9 +395,9 @@ void BrowserHistoryFrame::HighlightCurrentPage()
     Page* currentPage = m_history->getCurrentPage();
     if (!currentPage) return;
 
-    auto it = m_pageToTreeItem.find(currentPage);
-    if (it != m_pageToTreeItem.end()) {
-        wxTreeItemId itemId = it->second;
+    wxTreeItemId itemId = ShowPageItem(currentPage);
+    if (itemId.IsOk()) {
+        m_historyTree->UnselectAll();
         m_historyTree->SelectItem(itemId);
         m_historyTree->EnsureVisible(itemId);
 
@@ -289,12 +438,28 @@ void BrowserHistoryFrame::RefreshNavigationButtons()
 
 Page* BrowserHistoryFrame::GetPageFromTreeItem(const wxTreeItemId& item)
 {
-    for (const auto& pair : m_pageToTreeItem) {
-        if (pair.second == item) {
-            return pair.first;
-        }
+    if (!item.IsOk()) return nullptr;
+
+    PageItemData* data = static_cast<PageItemData*>(m_historyTree->GetItemData(item));
+    return data ? data->GetPage() : nullptr;
+}
+
+wxTreeItemId BrowserHistoryFrame::GetTreeItemFromPage(Page* page) const
+{
+    return wxTreeItemId(page ? page->getViewHandle() : nullptr);
+}
+
+ConcurrentHistory::WriteLock BrowserHistoryFrame::LockHistory()
+{
+    if (m_searchWorker) {
+        m_searchWorker->cancelRunning();
     }
-    return nullptr;
+    return m_sharedHistory->lockForWriting();
+}
+
+void BrowserHistoryFrame::OnJournalTimer(wxTimerEvent& event)
+{
+    m_journal->flushIfDue();
 }
 
 void BrowserHistoryFrame::ShowPageViewWindow(Page* page)
@@ -338,32 +503,32 @@ void BrowserHistoryFrame::ShowPageViewWindow(Page* page)
 
 void BrowserHistoryFrame::OnBackButton(wxCommandEvent& event)
 {
+    auto lock = LockHistory();
     if (m_history->goBack()) {
-        UpdateHistoryTree();
         RefreshNavigationButtons();
     }
 }
 
 void BrowserHistoryFrame::OnForwardButton(wxCommandEvent& event)
 {
+    auto lock = LockHistory();
     if (m_history->goForward()) {
-        UpdateHistoryTree();
         RefreshNavigationButtons();
     }
 }
 
 void BrowserHistoryFrame::OnHomeButton(wxCommandEvent& event)
 {
+    auto lock = LockHistory();
     if (m_history->goToHome()) {
-        UpdateHistoryTree();
         RefreshNavigationButtons();
     }
 }
 
 void BrowserHistoryFrame::OnRefreshButton(wxCommandEvent& event)
 {
+    auto lock = LockHistory();
     m_history->refresh();
-    UpdateHistoryTree();
     RefreshNavigationButtons();
 }
 
@@ -371,54 +536,70 @@ void BrowserHistoryFrame::OnGoButton(wxCommandEvent& event)
 {
     wxString url = m_urlBar->GetValue();
     if (!url.IsEmpty()) {
+        auto lock = LockHistory();
         m_history->visit(url.ToStdString(), "Page at " + url.ToStdString());
-        UpdateHistoryTree();
         RefreshNavigationButtons();
     }
 }
 
 void BrowserHistoryFrame::OnSearchButton(wxCommandEvent& event)
 {
-    wxString searchText = m_searchBar->GetValue();
-    if (searchText.IsEmpty()) return;
+    if (m_searchBar->GetValue().IsEmpty()) return;
 
-    vector<Page*> results;
+    m_dialogSearch = SubmitSearch();
+    SetStatusText("Searching...");
+}
+
+void BrowserHistoryFrame::OnSearchTextChanged(wxCommandEvent& event)
+{
+    if (m_searchBar->GetValue().IsEmpty()) {
+        m_lastSearch = 0;
+        SetStatusText("Ready");
+        return;
+    }
+    SubmitSearch();
+}
+
+unsigned int BrowserHistoryFrame::SubmitSearch()
+{
+    string searchText = m_searchBar->GetValue().ToStdString();
     int searchType = m_searchTypeChoice->GetSelection();
 
-    if (searchType == 0) { 
-        results = m_history->findPagesByTitle(searchText.ToStdString());
+    if (searchType == 1) {
+        m_lastSearch = m_searchWorker->submit("", searchText);
     }
-    else if (searchType == 1) {  
-        vector<Page*> allPages;
-        Page* rootPage = m_history->getCurrentPage();
-        while (rootPage->getParent() != nullptr) {
-            rootPage = rootPage->getParent();
-        }
-        m_history->collectAllPages(rootPage, allPages);
+    else if (searchType == 2) {
+        m_lastSearch = m_searchWorker->submit("", "", searchText);
+    }
+    else {
+        m_lastSearch = m_searchWorker->submit(searchText);
+    }
+    return m_lastSearch;
+}
 
-        for (Page* page : allPages) {
-            if (page->getUrl().find(searchText.ToStdString()) != string::npos) {
-                results.push_back(page);
-            }
+void BrowserHistoryFrame::OnSearchResults(unsigned int generation, const vector<unsigned int>& pageIDs)
+{
+    if (generation != m_lastSearch) return;
+
+    vector<Page*> results;
+    for (unsigned int id : pageIDs) {
+        Page* page = m_history->findPageByID(id);
+        if (page) {
+            results.push_back(page);
         }
     }
-    else if (searchType == 2) {  
-        vector<Page*> allPages;
-        Page* rootPage = m_history->getCurrentPage();
-        while (rootPage->getParent() != nullptr) {
-            rootPage = rootPage->getParent();
-        }
-        m_history->collectAllPages(rootPage, allPages);
+    SetStatusText(wxString::Format("%d matching pages", (int)results.size()));
 
-        for (Page* page : allPages) {
-            if (page->getSessionID() == searchText.ToStdString()) {
-                results.push_back(page);
-            }
-        }
+    if (generation == m_dialogSearch) {
+        m_dialogSearch = 0;
+        ShowSearchResults(results);
     }
+}
 
+void BrowserHistoryFrame::ShowSearchResults(const vector<Page*>& results)
+{
     if (results.empty()) {
-        wxMessageBox("No pages found matching '" + searchText + "'", "Search Results");
+        wxMessageBox("No pages found matching '" + m_searchBar->GetValue() + "'", "Search Results");
         return;
     }
 
@@ -440,20 +621,8 @@ void BrowserHistoryFrame::OnSearchButton(wxCommandEvent& event)
     openBtn->Bind(wxEVT_BUTTON, [this, resultsList, results, dialog](wxCommandEvent&) {
         int selection = resultsList->GetSelection();
         if (selection != wxNOT_FOUND && selection < (int)results.size()) {
-            Page* selectedPage = results[selection];
-
-            vector<Page*> path;
-            Page* rootPage = m_history->getCurrentPage();
-            while (rootPage->getParent() != nullptr) {
-                rootPage = rootPage->getParent();
-            }
-
-            if (m_history->findPageInTree(rootPage, selectedPage->getUrl(), path)) {
-                for (Page* pathPage : path) {
-                    m_history->goToURL(pathPage->getUrl());
-                }
-
-                UpdateHistoryTree();
+            auto lock = LockHistory();
+            if (m_history->goToPage(results[selection])) {
                 RefreshNavigationButtons();
             }
 
@@ -475,14 +644,31 @@ void BrowserHistoryFrame::OnTreeSelectionChanged(wxTreeEvent& event)
     }
 }
 
+void BrowserHistoryFrame::OnTreeItemExpanding(wxTreeEvent& event)
+{
+    wxTreeItemId itemId = event.GetItem();
+    PopulateChildren(GetPageFromTreeItem(itemId), itemId);
+}
+
+void BrowserHistoryFrame::OnTreeItemCollapsed(wxTreeEvent& event)
+{
+    wxTreeItemId itemId = event.GetItem();
+    Page* page = GetPageFromTreeItem(itemId);
+    if (!page) return;
+
+    ForgetChildItems(page);
+    m_historyTree->DeleteChildren(itemId);
+    m_historyTree->SetItemHasChildren(itemId, !page->getChildren().empty());
+}
+
 void BrowserHistoryFrame::OnTreeItemActivated(wxTreeEvent& event)
 {
     wxTreeItemId itemId = event.GetItem();
     Page* page = GetPageFromTreeItem(itemId);
 
     if (page) {
-        m_history->goToURL(page->getUrl());
-        UpdateHistoryTree();
+        auto lock = LockHistory();
+        m_history->goToPage(page);
         RefreshNavigationButtons();
 
         ShowPageViewWindow(page);
@@ -491,6 +677,7 @@ void BrowserHistoryFrame::OnTreeItemActivated(wxTreeEvent& event)
 
 void BrowserHistoryFrame::OnNewSessionButton(wxCommandEvent& event)
 {
+    auto lock = LockHistory();
     m_history->startNewSession();
     SetStatusText("New browsing session started.");
 }
@@ -501,8 +688,8 @@ void BrowserHistoryFrame::OnClearHistoryButton(wxCommandEvent& event)
         "Confirm Clear History", wxYES_NO | wxNO_DEFAULT | wxICON_QUESTION);
 
     if (dialog.ShowModal() == wxID_YES) {
+        auto lock = LockHistory();
         m_history->clearHistory();
-        UpdateHistoryTree();
         RefreshNavigationButtons();
         SetStatusText("Browsing history cleared.");
     }
@@ -513,6 +700,25 @@ void BrowserHistoryFrame::OnExit(wxCommandEvent& event)
     Close(true);
 }
 
+void BrowserHistoryFrame::OnImport(wxCommandEvent& event)
+{
+    wxFileDialog dialog(this, "Import History", "", "",
+        "Tab-separated dumps (*.tsv)|*.tsv|JSON Lines dumps (*.jsonl)|*.jsonl", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+    if (dialog.ShowModal() != wxID_OK) {
+        return;
+    }
+
+    ImportFormat format = dialog.GetFilterIndex() == 1 ? ImportFormat::JSONL : ImportFormat::TSV;
+    ImportStats stats;
+    auto lock = LockHistory();
+    if (!importHistory(*m_history, dialog.GetPath().ToStdString(), format, &stats)) {
+        wxMessageBox("Could not open " + dialog.GetPath(), "Import History", wxOK | wxICON_ERROR);
+        return;
+    }
+    RefreshNavigationButtons();
+    SetStatusText(wxString::Format("Imported %d pages, skipped %d lines", (int)stats.imported, (int)stats.skipped));
+}
+
 void BrowserHistoryFrame::OnAbout(wxCommandEvent& event)
 {
     wxAboutDialogInfo info;
@@ -5,17 +5,44 @@
 #include <wx/splitter.h>
 #include <wx/statline.h>
 #include <wx/datetime.h>
+#include <wx/timer.h>
 #include "browser history.h"
 #include "page.h"
+#include "history observer.h"
+#include "search worker.h"
+#include "history journal.h"
 
-class BrowserHistoryFrame : public wxFrame
+class PageItemData : public wxTreeItemData
+{
+public:
+    PageItemData(Page* page) : m_page(page) {}
+    Page* GetPage() const { return m_page; }
+
+private:
+    Page* m_page;
+};
+
+class BrowserHistoryFrame : public wxFrame, public HistoryObserver
 {
 public:
     BrowserHistoryFrame(const wxString& title);
     ~BrowserHistoryFrame();
 
+    void onPageAdded(Page* page) override;
+    void onPageRemoving(Page* page) override;
+    void onCurrentPageChanged(Page* previous, Page* current) override;
+    void onHistoryCleared() override;
+    bool wantsBatchedEvents() const override;
+    void onBatchCommitted() override;
+
 private:
+    ConcurrentHistory* m_sharedHistory;
     BrowserHistory* m_history;
+    SearchWorker* m_searchWorker;
+    HistoryJournal* m_journal;
+    wxTimer m_journalTimer;
+    unsigned int m_lastSearch;
+    unsigned int m_dialogSearch;
 
     wxSplitterWindow* m_splitter;
     wxPanel* m_leftPanel;
@@ -23,7 +50,6 @@ private:
 
     wxTreeCtrl* m_historyTree;
     wxTreeItemId m_rootId;
-    std::map<Page*, wxTreeItemId> m_pageToTreeItem;
 
     wxButton* m_backBtn;
     wxButton* m_forwardBtn;
@@ -52,9 +78,17 @@ private:
     void RefreshNavigationButtons();
     void ShowPageViewWindow(Page* page);
 
-    void PopulateTree(Page* page, const wxTreeItemId& parentId);
+    wxTreeItemId AppendPageItem(Page* page, const wxTreeItemId& parentId);
+    void PopulateChildren(Page* page, const wxTreeItemId& itemId);
+    void ForgetChildItems(Page* page);
+    wxTreeItemId ShowPageItem(Page* page);
     void HighlightCurrentPage();
     Page* GetPageFromTreeItem(const wxTreeItemId& item);
+    ConcurrentHistory::WriteLock LockHistory();
+    unsigned int SubmitSearch();
+    void OnSearchResults(unsigned int generation, const vector<unsigned int>& pageIDs);
+    void ShowSearchResults(const vector<Page*>& results);
+    wxTreeItemId GetTreeItemFromPage(Page* page) const;
 
     void OnBackButton(wxCommandEvent& event);
     void OnForwardButton(wxCommandEvent& event);
@@ -62,13 +96,18 @@ private:
     void OnRefreshButton(wxCommandEvent& event);
     void OnGoButton(wxCommandEvent& event);
     void OnSearchButton(wxCommandEvent& event);
+    void OnSearchTextChanged(wxCommandEvent& event);
     void OnTreeSelectionChanged(wxTreeEvent& event);
     void OnTreeItemActivated(wxTreeEvent& event);
+    void OnTreeItemExpanding(wxTreeEvent& event);
+    void OnTreeItemCollapsed(wxTreeEvent& event);
     void OnNewSessionButton(wxCommandEvent& event);
     void OnClearHistoryButton(wxCommandEvent& event);
 
     void OnExit(wxCommandEvent& event);
+    void OnJournalTimer(wxTimerEvent& event);
     void OnAbout(wxCommandEvent& event);
+    void OnImport(wxCommandEvent& event);
 
     DECLARE_EVENT_TABLE()
 };